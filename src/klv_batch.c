@@ -0,0 +1,811 @@
+/**
+ * klv_batch.c: decode many input files on a pool of work-stealing workers
+ * @author Kongsberg Geospatial Ltd.
+ * @author www.kongsberggeospatial.com
+ * @copyright 2022 Kongsberg Geospatial Ltd.
+ */
+
+#include "klv_batch.h"
+
+#if defined(_WIN32)
+
+int klv_batch_run(const char *const *paths, size_t num_paths, const klv_batch_options_t *options) {
+  (void)paths;
+  (void)num_paths;
+  (void)options;
+  fprintf(stderr, "Batch mode is not supported on this platform\n");
+  return -1;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/Config.h"
+#include "libklv/libklv_archive.h"
+#include "libklv/libklv_mp4.h"
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define BATCH_HAVE_URING
+#endif
+#endif
+
+/*
+ * Every input file is cut into tasks of at most BATCH_CHUNK_SIZE bytes. A task
+ * owns the packets that start inside its range and reads up to one maximum
+ * packet past the end so the last of them is complete. Tasks are sorted
+ * largest first and dealt round-robin onto per-worker deques, so consecutive
+ * chunks of a big file land on different workers. A worker takes work from
+ * the front of its own deque and, once that is empty, steals from the back
+ * of the others'. Tasks are whole megabytes of decoding, so a mutex per deque
+ * costs nothing measurable.
+ *
+ * Each worker keeps the read of its next task in flight while it decodes the
+ * current one, through its own io_uring when the kernel allows it and with
+ * plain pread() otherwise. Decoded output of a chunk is buffered in memory
+ * and appended to the file's output in chunk order by whichever worker
+ * completes the next chunk due.
+ *
+ * Archives and MP4 files cannot be cut at arbitrary bytes, so each is read
+ * and decoded whole, as a single task, through its reader.
+ */
+
+#define BATCH_OVERLAP (LIBKLV_MAX_PACKET_SIZE + 16 + 9) /* key + longest BER length + largest payload */
+
+typedef struct batch_output_s {
+  char *data;
+  size_t size;
+  bool ready; /* decoded, waiting for the chunks before it */
+} batch_output_t;
+
+typedef struct batch_file_s {
+  const char *path;
+  char *out_path; /* NULL when the format writes nothing */
+  uint64_t size;
+  uint32_t num_chunks;
+  bool whole; /* an archive or MP4 file, decoded as one task through its reader */
+
+  mtx_t lock;             /* guards the fields below */
+  uint32_t next_flush;    /* next chunk to append to out */
+  batch_output_t *chunks; /* decoded output by chunk index */
+  FILE *out;              /* opened at the first flush, closed after the last */
+  bool failed;
+} batch_file_t;
+
+typedef struct batch_task_s {
+  batch_file_t *file;
+  uint32_t chunk;
+  uint64_t offset; /* first byte of the chunk */
+  uint64_t length; /* packets starting in [offset, offset + length) belong to this chunk */
+} batch_task_t;
+
+typedef struct batch_deque_s {
+  mtx_t lock;
+  batch_task_t **tasks;
+  size_t head; /* owner takes from here */
+  size_t tail; /* thieves take from here */
+} batch_deque_t;
+
+typedef struct batch_read_s {
+  batch_task_t *task;
+  int fd;
+  uint8_t *buf;
+  size_t capacity;
+  size_t want; /* bytes to read: the chunk plus its overlap, clipped to the file */
+  size_t got;
+  bool pending; /* a read is queued on the ring */
+  int error;    /* errno of a failed read */
+  struct iovec iov;
+} batch_read_t;
+
+#if defined(BATCH_HAVE_URING)
+typedef struct batch_uring_s {
+  int fd;
+  atomic_uint *sq_head;
+  atomic_uint *sq_tail;
+  unsigned sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  atomic_uint *cq_head;
+  atomic_uint *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ring;
+  void *cq_ring;
+  size_t sq_ring_size;
+  size_t cq_ring_size;
+  size_t sqes_size;
+} batch_uring_t;
+#endif
+
+struct batch_s;
+
+typedef struct batch_worker_s {
+  struct batch_s *batch;
+  unsigned index;
+  thrd_t thread;
+  batch_deque_t queue;
+  klv_ctx_t *ctx; /* reused for every chunk the worker decodes */
+  batch_read_t reads[BATCH_READS_IN_FLIGHT];
+#if defined(BATCH_HAVE_URING)
+  batch_uring_t ring;
+#endif
+  bool use_uring;
+  uint64_t tasks_done;
+  uint64_t steals;
+  uint64_t reports[LIBKLV_REPORT_COUNT]; /* parse events of the worker's context, by klv_report_t */
+} batch_worker_t;
+
+typedef struct batch_s {
+  klv_output_format_t format;
+  unsigned num_workers;
+  batch_worker_t *workers;
+  atomic_uint failed_files;
+} batch_t;
+
+#if defined(BATCH_HAVE_URING)
+/*****************************************************************************
+ * uring_init
+ *
+ * Set up a ring with raw system calls, liburing is not required.
+ *****************************************************************************/
+static int uring_init(batch_uring_t *ring, unsigned entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  memset(ring, 0, sizeof(*ring));
+
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0)
+    return -1;
+
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_size > ring->sq_ring_size)
+      ring->sq_ring_size = ring->cq_ring_size;
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED)
+    goto close_fd;
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED)
+      goto unmap_sq;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED)
+    goto unmap_cq;
+
+  uint8_t *sq = (uint8_t *)ring->sq_ring;
+  uint8_t *cq = (uint8_t *)ring->cq_ring;
+  ring->sq_head = (atomic_uint *)(sq + params.sq_off.head);
+  ring->sq_tail = (atomic_uint *)(sq + params.sq_off.tail);
+  ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->cq_head = (atomic_uint *)(cq + params.cq_off.head);
+  ring->cq_tail = (atomic_uint *)(cq + params.cq_off.tail);
+  ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  return 0;
+
+unmap_cq:
+  if (ring->cq_ring != ring->sq_ring)
+    munmap(ring->cq_ring, ring->cq_ring_size);
+unmap_sq:
+  munmap(ring->sq_ring, ring->sq_ring_size);
+close_fd:
+  close(ring->fd);
+  return -1;
+}
+
+/*****************************************************************************
+ * uring_free
+ *****************************************************************************/
+static void uring_free(batch_uring_t *ring) {
+  munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring != ring->sq_ring)
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  munmap(ring->sq_ring, ring->sq_ring_size);
+  close(ring->fd);
+}
+
+/*****************************************************************************
+ * uring_submit_read
+ *
+ * Queue one readv of read->iov at offset and submit it. Returns -1, with the
+ * SQE withdrawn, when the kernel does not take it.
+ *****************************************************************************/
+static int uring_submit_read(batch_uring_t *ring, batch_read_t *read, uint64_t offset) {
+  unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+  unsigned index = tail & ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READV; /* available since the first io_uring kernels, unlike IORING_OP_READ */
+  sqe->fd = read->fd;
+  sqe->addr = (uint64_t)(uintptr_t)&read->iov;
+  sqe->len = 1;
+  sqe->off = offset;
+  sqe->user_data = (uint64_t)(uintptr_t)read;
+  ring->sq_array[index] = index;
+  atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
+
+  for (;;) {
+    long ret = syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0);
+    if (ret == 1)
+      return 0;
+    if (ret < 0 && errno == EINTR)
+      continue;
+    /* not consumed: withdraw the SQE so it cannot be submitted later with a stale buffer */
+    atomic_store_explicit(ring->sq_tail, tail, memory_order_release);
+    return -1;
+  }
+}
+
+/*****************************************************************************
+ * uring_wait
+ *
+ * Block for the next completion.
+ *****************************************************************************/
+static int uring_wait(batch_uring_t *ring, batch_read_t **read, int *res) {
+  for (;;) {
+    unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    if (head != atomic_load_explicit(ring->cq_tail, memory_order_acquire)) {
+      struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+      *read = (batch_read_t *)(uintptr_t)cqe->user_data;
+      *res = cqe->res;
+      atomic_store_explicit(ring->cq_head, head + 1, memory_order_release);
+      return 0;
+    }
+    if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+      return -1;
+  }
+}
+#endif
+
+/*****************************************************************************
+ * queue_pop_front
+ *****************************************************************************/
+static batch_task_t *queue_pop_front(batch_deque_t *queue) {
+  batch_task_t *task = NULL;
+  mtx_lock(&queue->lock);
+  if (queue->head < queue->tail)
+    task = queue->tasks[queue->head++];
+  mtx_unlock(&queue->lock);
+  return task;
+}
+
+/*****************************************************************************
+ * queue_pop_back
+ *****************************************************************************/
+static batch_task_t *queue_pop_back(batch_deque_t *queue) {
+  batch_task_t *task = NULL;
+  mtx_lock(&queue->lock);
+  if (queue->head < queue->tail)
+    task = queue->tasks[--queue->tail];
+  mtx_unlock(&queue->lock);
+  return task;
+}
+
+/*****************************************************************************
+ * take_task
+ *
+ * Own work first, then steal. No tasks are added after the workers start, so
+ * NULL means all work has been handed out.
+ *****************************************************************************/
+static batch_task_t *take_task(batch_worker_t *worker) {
+  batch_t *batch = worker->batch;
+  batch_task_t *task = queue_pop_front(&worker->queue);
+
+  for (unsigned i = 1; task == NULL && i < batch->num_workers; i++) {
+    task = queue_pop_back(&batch->workers[(worker->index + i) % batch->num_workers].queue);
+    if (task != NULL)
+      worker->steals++;
+  }
+  return task;
+}
+
+/*****************************************************************************
+ * start_read
+ *****************************************************************************/
+static void start_read(batch_worker_t *worker, batch_read_t *read, batch_task_t *task) {
+  batch_file_t *file = task->file;
+  uint64_t end = task->offset + task->length + BATCH_OVERLAP;
+
+  read->task = task;
+  read->want = (size_t)(((end < file->size) ? end : file->size) - task->offset);
+  read->got = 0;
+  read->error = 0;
+  read->pending = false;
+
+  if (read->want > read->capacity) {
+    uint8_t *tmp = (uint8_t *)realloc(read->buf, read->want);
+    if (tmp == NULL) {
+      read->error = ENOMEM;
+      read->fd = -1;
+      return;
+    }
+    read->buf = tmp;
+    read->capacity = read->want;
+  }
+
+  read->fd = open(file->path, O_RDONLY);
+  if (read->fd < 0) {
+    read->error = errno;
+    return;
+  }
+
+#if defined(BATCH_HAVE_URING)
+  if (worker->use_uring) {
+    read->iov.iov_base = read->buf;
+    read->iov.iov_len = read->want;
+    read->pending = (uring_submit_read(&worker->ring, read, task->offset) == 0); /* else finish_read falls back to pread */
+  }
+#else
+  (void)worker;
+#endif
+}
+
+/*****************************************************************************
+ * finish_read
+ *
+ * Wait until read holds all its bytes, resubmitting short reads. Completions
+ * of the worker's other reads are accounted as they arrive.
+ *****************************************************************************/
+static void finish_read(batch_worker_t *worker, batch_read_t *read) {
+#if defined(BATCH_HAVE_URING)
+  while (read->pending) {
+    batch_read_t *done = NULL;
+    int res = 0;
+    if (uring_wait(&worker->ring, &done, &res) < 0) {
+      read->error = errno;
+      read->pending = false;
+      break;
+    }
+    done->pending = false;
+    if (res < 0) {
+      done->error = -res;
+    } else if (res == 0) {
+      done->want = done->got; /* the file shrank since it was sized */
+    } else {
+      done->got += (size_t)res;
+      if (done->got < done->want) {
+        done->iov.iov_base = done->buf + done->got;
+        done->iov.iov_len = done->want - done->got;
+        done->pending = (uring_submit_read(&worker->ring, done, done->task->offset + done->got) == 0);
+      }
+    }
+  }
+#else
+  (void)worker;
+#endif
+
+  while (read->error == 0 && read->got < read->want) {
+    ssize_t n = pread(read->fd, read->buf + read->got, read->want - read->got, (off_t)(read->task->offset + read->got));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      read->error = errno;
+    else if (n == 0)
+      read->want = read->got;
+    else
+      read->got += (size_t)n;
+  }
+
+  if (read->fd >= 0)
+    close(read->fd);
+  read->fd = -1;
+}
+
+/*****************************************************************************
+ * flush_chunk
+ *
+ * Hand over the output of one chunk and append every chunk now due to the
+ * file's output, in order.
+ *****************************************************************************/
+static void flush_chunk(batch_t *batch, batch_file_t *file, uint32_t chunk, char *data, size_t size, bool failed) {
+  mtx_lock(&file->lock);
+  file->chunks[chunk].data = data;
+  file->chunks[chunk].size = size;
+  file->chunks[chunk].ready = true;
+  file->failed |= failed;
+
+  while (file->next_flush < file->num_chunks && file->chunks[file->next_flush].ready) {
+    batch_output_t *output = &file->chunks[file->next_flush++];
+    if (file->out_path != NULL && file->out == NULL && !file->failed) {
+      file->out = fopen(file->out_path, "wb");
+      if (file->out == NULL) {
+        fprintf(stderr, "Unable to open %s\n", file->out_path);
+        file->failed = true;
+      }
+    }
+    if (file->out != NULL && output->size > 0 && fwrite(output->data, 1, output->size, file->out) != output->size)
+      file->failed = true;
+    free(output->data);
+    output->data = NULL;
+  }
+
+  if (file->next_flush == file->num_chunks) {
+    if (file->out != NULL && fclose(file->out) != 0)
+      file->failed = true;
+    file->out = NULL;
+    if (file->failed)
+      atomic_fetch_add(&batch->failed_files, 1);
+  }
+  mtx_unlock(&file->lock);
+}
+
+/*****************************************************************************
+ * count_report
+ *
+ * Workers count parse events instead of printing them, so they never
+ * contend for stderr.
+ *****************************************************************************/
+static void count_report(void *user, klv_report_t report, uint8_t id) {
+  (void)id;
+  ((uint64_t *)user)[report]++;
+}
+
+/*****************************************************************************
+ * decode_whole
+ *
+ * Decode an archive or MP4 file read whole into buf. Returns -1 when it is
+ * malformed, or an MP4 file has no KLV track.
+ *****************************************************************************/
+static int decode_whole(klv_ctx_t *ctx, const uint8_t *buf, size_t size) {
+  int ret = -1;
+
+  if (libklv_is_archive(buf, size)) {
+    klv_archive_reader_t *reader = libklv_archive_reader_init(buf, size);
+    while (reader != NULL && (ret = libklv_archive_read_packet(reader, ctx)) > 0) {
+      struct list_head *items = &ctx->klv_items.list;
+      libklv_write_packet(&ctx->writer, items->next, items);
+    }
+    libklv_archive_reader_cleanup(reader);
+  } else {
+    klv_mp4_reader_t *reader = libklv_mp4_reader_init(buf, size);
+    while (reader != NULL && (ret = libklv_mp4_read_sample(reader, ctx, NULL)) > 0)
+      ;
+    libklv_mp4_reader_cleanup(reader);
+  }
+  return (ret < 0) ? -1 : 0;
+}
+
+/*****************************************************************************
+ * decode_chunk
+ *****************************************************************************/
+static void decode_chunk(batch_worker_t *worker, batch_read_t *read) {
+  batch_task_t *task = read->task;
+  batch_file_t *file = task->file;
+  char *data = NULL;
+  size_t size = 0;
+  FILE *out = NULL;
+
+  if (read->error != 0) {
+    fprintf(stderr, "Unable to read %s: %s\n", file->path, strerror(read->error));
+    flush_chunk(worker->batch, file, task->chunk, NULL, 0, true);
+    return;
+  }
+
+  if (file->out_path != NULL) {
+    out = open_memstream(&data, &size);
+    if (out == NULL) {
+      flush_chunk(worker->batch, file, task->chunk, NULL, 0, true);
+      return;
+    }
+  }
+  libklv_set_output(worker->ctx, out, (out != NULL) ? worker->batch->format : LIBKLV_OUTPUT_NONE);
+  libklv_set_version(worker->ctx, -1); /* the chunk's stream names its own version */
+
+  bool failed = false;
+  size_t offset = 0;
+  size_t start = 0;
+  size_t len = 0;
+  size_t limit = (read->got < task->length) ? read->got : (size_t)task->length;
+  if (file->whole) {
+    failed = (decode_whole(worker->ctx, read->buf, read->got) < 0);
+    if (failed)
+      fprintf(stderr, "Unable to decode %s\n", file->path);
+    offset = limit = read->got;
+  }
+  while (offset < limit && libklv_frame_packet(read->buf + offset, read->got - offset, &start, &len)) {
+    if (offset + start >= limit)
+      break; /* starts in the next chunk */
+    libklv_borrow_ctx_buffer(worker->ctx, read->buf + offset + start, len);
+    libklv_parse_data(worker->ctx);
+    offset += start + len;
+  }
+
+  if (task->chunk == file->num_chunks - 1 && offset < read->got) {
+    /* a truncated packet at the end of the file, decoded as far as it goes like the single-file path */
+    libklv_borrow_ctx_buffer(worker->ctx, read->buf + offset, read->got - offset);
+    libklv_parse_data(worker->ctx);
+  }
+
+  if (out != NULL) {
+    libklv_writer_finish(&worker->ctx->writer);
+    fclose(out);
+  }
+  libklv_borrow_ctx_buffer(worker->ctx, NULL, 0);
+  flush_chunk(worker->batch, file, task->chunk, data, size, failed);
+}
+
+/*****************************************************************************
+ * worker_main
+ *****************************************************************************/
+static int worker_main(void *arg) {
+  batch_worker_t *worker = (batch_worker_t *)arg;
+  batch_read_t *current = &worker->reads[0];
+  batch_read_t *next = &worker->reads[1];
+  batch_task_t *task = take_task(worker);
+
+  if (task != NULL)
+    start_read(worker, current, task);
+
+  while (task != NULL) {
+    /* queue the following read before decoding, so the disk works while the CPU does */
+    batch_task_t *next_task = take_task(worker);
+    if (next_task != NULL)
+      start_read(worker, next, next_task);
+
+    finish_read(worker, current);
+    decode_chunk(worker, current);
+    worker->tasks_done++;
+
+    batch_read_t *tmp = current;
+    current = next;
+    next = tmp;
+    task = next_task;
+  }
+
+  return 0;
+}
+
+/*****************************************************************************
+ * is_whole_file
+ *
+ * Whether the file at path is an archive or MP4 file, from its first bytes.
+ *****************************************************************************/
+static bool is_whole_file(const char *path) {
+  uint8_t head[LIBKLV_ARCHIVE_HEADER_SIZE];
+  ssize_t n = -1;
+  int fd = open(path, O_RDONLY);
+
+  if (fd >= 0) {
+    while ((n = pread(fd, head, sizeof(head), 0)) < 0 && errno == EINTR)
+      ;
+    close(fd);
+  }
+  return n > 0 && (libklv_is_archive(head, (size_t)n) || libklv_is_mp4(head, (size_t)n));
+}
+
+/*****************************************************************************
+ * compare_tasks
+ *
+ * Largest first, so the long tasks are not the ones left over at the end.
+ *****************************************************************************/
+static int compare_tasks(const void *a, const void *b) {
+  const batch_task_t *ta = *(const batch_task_t *const *)a;
+  const batch_task_t *tb = *(const batch_task_t *const *)b;
+  return (ta->length < tb->length) - (ta->length > tb->length);
+}
+
+/*****************************************************************************
+ * output_path
+ *****************************************************************************/
+static char *output_path(const char *path, const char *out_dir, klv_output_format_t format) {
+  static const char *const extensions[] = {
+      [LIBKLV_OUTPUT_JSON] = ".json",
+      [LIBKLV_OUTPUT_MSGPACK] = ".msgpack",
+      [LIBKLV_OUTPUT_CBOR] = ".cbor",
+      [LIBKLV_OUTPUT_RECORD] = ".rec",
+      [LIBKLV_OUTPUT_ARCHIVE] = ".kla",
+      [LIBKLV_OUTPUT_GEOJSON] = ".geojson",
+      [LIBKLV_OUTPUT_WKB] = ".wkb",
+  };
+  const char *extension = extensions[format];
+  const char *name = path;
+  size_t dir_len = 0;
+
+  if (out_dir != NULL) {
+    const char *slash = strrchr(path, '/');
+    name = (slash != NULL) ? slash + 1 : path;
+    dir_len = strlen(out_dir) + 1;
+  }
+
+  char *out = (char *)malloc(dir_len + strlen(name) + strlen(extension) + 1);
+  if (out == NULL)
+    return NULL;
+  if (out_dir != NULL)
+    sprintf(out, "%s/%s%s", out_dir, name, extension);
+  else
+    sprintf(out, "%s%s", name, extension);
+  return out;
+}
+
+/*****************************************************************************
+ * klv_batch_run
+ *****************************************************************************/
+int klv_batch_run(const char *const *paths, size_t num_paths, const klv_batch_options_t *options) {
+  batch_t batch;
+  batch_file_t *files = NULL;
+  batch_task_t *tasks = NULL;
+  batch_task_t **order = NULL;
+  size_t num_files = 0;
+  size_t num_tasks = 0;
+  uint64_t total_bytes = 0;
+  unsigned started = 0;
+  int ret = -1;
+  struct timespec t0, t1;
+
+  timespec_get(&t0, TIME_UTC);
+
+  memset(&batch, 0, sizeof(batch));
+  batch.format = options->format;
+  batch.num_workers = options->jobs;
+  if (batch.num_workers == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    batch.num_workers = (cpus > 0) ? (unsigned)cpus : 1;
+  }
+  atomic_init(&batch.failed_files, 0);
+
+  /* size every file and cut it into chunks */
+  files = (batch_file_t *)calloc(num_paths, sizeof(batch_file_t));
+  if (files == NULL)
+    return -1;
+  for (size_t i = 0; i < num_paths; i++) {
+    struct stat st;
+    if (stat(paths[i], &st) != 0 || !S_ISREG(st.st_mode)) {
+      fprintf(stderr, "Unable to open %s\n", paths[i]);
+      atomic_fetch_add(&batch.failed_files, 1);
+      continue;
+    }
+    batch_file_t *file = &files[num_files];
+    file->path = paths[i];
+    file->size = (uint64_t)st.st_size;
+    file->whole = is_whole_file(paths[i]);
+    file->num_chunks = file->whole ? 1 : (uint32_t)((file->size + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE);
+    if (file->num_chunks == 0)
+      file->num_chunks = 1; /* an empty file still gets its (empty) output */
+    if (options->format != LIBKLV_OUTPUT_NONE) {
+      file->out_path = output_path(paths[i], options->out_dir, options->format);
+      if (file->out_path == NULL)
+        goto free_files;
+    }
+    file->chunks = (batch_output_t *)calloc(file->num_chunks, sizeof(batch_output_t));
+    if (file->chunks == NULL || mtx_init(&file->lock, mtx_plain) != thrd_success) {
+      free(file->chunks);
+      free(file->out_path);
+      goto free_files;
+    }
+    num_files++;
+    num_tasks += file->num_chunks;
+    total_bytes += file->size;
+  }
+
+  tasks = (batch_task_t *)calloc(num_tasks, sizeof(batch_task_t));
+  order = (batch_task_t **)calloc(num_tasks, sizeof(batch_task_t *));
+  batch.workers = (batch_worker_t *)calloc(batch.num_workers, sizeof(batch_worker_t));
+  if ((num_tasks > 0 && (tasks == NULL || order == NULL)) || batch.workers == NULL)
+    goto free_tasks;
+
+  size_t n = 0;
+  for (size_t i = 0; i < num_files; i++) {
+    for (uint32_t chunk = 0; chunk < files[i].num_chunks; chunk++, n++) {
+      uint64_t offset = (uint64_t)chunk * BATCH_CHUNK_SIZE;
+      tasks[n].file = &files[i];
+      tasks[n].chunk = chunk;
+      tasks[n].offset = offset;
+      tasks[n].length = (files[i].whole || files[i].size - offset < BATCH_CHUNK_SIZE) ? files[i].size - offset : BATCH_CHUNK_SIZE;
+      order[n] = &tasks[n];
+    }
+  }
+  if (num_tasks > 0)
+    qsort(order, num_tasks, sizeof(batch_task_t *), compare_tasks);
+
+  /* deal the tasks round-robin, every deque gets a slice of the big ones */
+  size_t per_worker = num_tasks / batch.num_workers + 1;
+  for (unsigned w = 0; w < batch.num_workers; w++) {
+    batch_worker_t *worker = &batch.workers[w];
+    worker->batch = &batch;
+    worker->index = w;
+    for (unsigned r = 0; r < BATCH_READS_IN_FLIGHT; r++)
+      worker->reads[r].fd = -1;
+    worker->queue.tasks = (batch_task_t **)calloc(per_worker, sizeof(batch_task_t *));
+    worker->ctx = libklv_init();
+    if (worker->queue.tasks == NULL || worker->ctx == NULL || mtx_init(&worker->queue.lock, mtx_plain) != thrd_success) {
+      free(worker->queue.tasks);
+      libklv_cleanup(worker->ctx);
+      goto free_workers;
+    }
+    worker->ctx->filter = options->filter;
+    libklv_set_report(worker->ctx, count_report, worker->reports);
+#if defined(BATCH_HAVE_URING)
+    worker->use_uring = (uring_init(&worker->ring, 2 * BATCH_READS_IN_FLIGHT) == 0);
+#endif
+    started++;
+  }
+  for (size_t i = 0; i < num_tasks; i++) {
+    batch_deque_t *queue = &batch.workers[i % batch.num_workers].queue;
+    queue->tasks[queue->tail++] = order[i];
+  }
+
+  unsigned running = 0;
+  for (; running < batch.num_workers; running++) {
+    if (thrd_create(&batch.workers[running].thread, worker_main, &batch.workers[running]) != thrd_success)
+      break;
+  }
+  /* any worker that failed to start has its tasks stolen by the others */
+  for (unsigned w = 0; w < running; w++)
+    thrd_join(batch.workers[w].thread, NULL);
+  if (running == 0) {
+    fprintf(stderr, "Unable to start batch workers\n");
+    goto free_workers;
+  }
+
+  timespec_get(&t1, TIME_UTC);
+  double seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+  uint64_t steals = 0;
+  uint64_t reports[LIBKLV_REPORT_COUNT] = {0};
+  unsigned uring_workers = 0;
+  for (unsigned w = 0; w < running; w++) {
+    steals += batch.workers[w].steals;
+    uring_workers += batch.workers[w].use_uring;
+    for (int r = 0; r < LIBKLV_REPORT_COUNT; r++)
+      reports[r] += batch.workers[w].reports[r];
+  }
+  fprintf(stderr, "batch: %zu files (%u failed), %zu chunks, %.1f MiB in %.2f s, %u workers (%u with io_uring), %" PRIu64 " steals\n",
+          num_files, atomic_load(&batch.failed_files), num_tasks, (double)total_bytes / (1 << 20), seconds, running, uring_workers, steals);
+  fprintf(stderr, "batch: %" PRIu64 " valid and %" PRIu64 " invalid checksums, %" PRIu64 " unhandled keys, %" PRIu64 " packets of other standards\n",
+          reports[LIBKLV_REPORT_CHECKSUM_VALID], reports[LIBKLV_REPORT_CHECKSUM_INVALID], reports[LIBKLV_REPORT_KEY_NOT_HANDLED],
+          reports[LIBKLV_REPORT_PACKET_NOT_HANDLED]);
+  ret = (atomic_load(&batch.failed_files) == 0) ? 0 : -1;
+
+free_workers:
+  for (unsigned w = 0; w < started; w++) {
+    batch_worker_t *worker = &batch.workers[w];
+#if defined(BATCH_HAVE_URING)
+    if (worker->use_uring)
+      uring_free(&worker->ring);
+#endif
+    for (unsigned r = 0; r < BATCH_READS_IN_FLIGHT; r++)
+      free(worker->reads[r].buf);
+    libklv_cleanup(worker->ctx);
+    mtx_destroy(&worker->queue.lock);
+    free(worker->queue.tasks);
+  }
+free_tasks:
+  free(batch.workers);
+  free(order);
+  free(tasks);
+free_files:
+  for (size_t i = 0; i < num_files; i++) {
+    for (uint32_t chunk = 0; chunk < files[i].num_chunks; chunk++)
+      free(files[i].chunks[chunk].data);
+    free(files[i].chunks);
+    free(files[i].out_path);
+    mtx_destroy(&files[i].lock);
+  }
+  free(files);
+  return ret;
+}
+
+#endif
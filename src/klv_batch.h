@@ -0,0 +1,28 @@
+/**
+ * klv_batch.h: decode many input files on a pool of work-stealing workers
+ * @author Kongsberg Geospatial Ltd.
+ * @author www.kongsberggeospatial.com
+ * @copyright 2022 Kongsberg Geospatial Ltd.
+ */
+
+#ifndef KLV_BATCH_H_INCLUDED
+#define KLV_BATCH_H_INCLUDED
+
+#include <stddef.h>
+
+#include "libklv/libklv.h"
+#include "libklv/libklv_filter.h"
+
+#define BATCH_CHUNK_SIZE (8 << 20) /* files larger than this are split into chunks decoded in parallel */
+#define BATCH_READS_IN_FLIGHT 2    /* reads each worker keeps queued while it decodes */
+
+typedef struct klv_batch_options_s {
+  unsigned jobs;              /* worker threads, 0 for one per online CPU */
+  const char *out_dir;        /* directory for the outputs, NULL to write next to each input */
+  klv_output_format_t format; /* output format of every file */
+  const klv_filter_t *filter; /* packets to keep, NULL for all */
+} klv_batch_options_t;
+
+int klv_batch_run(const char *const *paths, size_t num_paths, const klv_batch_options_t *options);
+
+#endif // KLV_BATCH_H_INCLUDED
@@ -0,0 +1,457 @@
+/**
+ * klv_pipeline.c: reader/decoder/writer threads connected by SPSC rings
+ * @author Kongsberg Geospatial Ltd.
+ * @author www.kongsberggeospatial.com
+ * @copyright 2022 Kongsberg Geospatial Ltd.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <io.h>
+#define read _read
+#define fstat _fstat
+#define stat _stat
+typedef int ssize_t;
+#else
+#include <unistd.h>
+#endif
+
+#include "include/Config.h"
+#include "klv_pipeline.h"
+#include "libklv/libklv_archive.h"
+#include "libklv/libklv_mp4.h"
+#include "spsc_ring.h"
+
+#if defined(HAVE_SYS_INOTIFY_H)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+/*
+ * Three stages, each on its own thread:
+ *
+ *   reader  --chunks-->  decoder  --packets-->  writer
+ *
+ * The reader only moves bytes from the input into chunk slots. The decoder
+ * frames packets across chunk boundaries and decodes each into the klv
+ * context owned by a packet slot. The writer serializes packet slots to the
+ * output. Both rings are sized so that either neighbour can stall for a while
+ * without the stage in the middle having to stop.
+ *
+ * When following a file, the reader waits at its end for more bytes instead
+ * of closing the chunk ring, and the writer flushes whenever it catches up.
+ * The decoder keeps an incomplete packet at the end of the file until the
+ * rest of it is appended. When the file is truncated, the reader marks the
+ * first chunk it reads again from the start, and the decoder drops the
+ * incomplete packet and the stream's version.
+ *
+ * Only raw KLV is streamed. Archives and MP4 files have to be read through
+ * their readers as a whole, so when the first chunk is one of them the
+ * decoder stops the pipeline and klv_pipeline_run fails.
+ *
+ * When reordering, the writer holds packets back in a klv_reorder_t. It keeps
+ * a held packet's whole context and gives the slot a spare context in its
+ * place, so the decoded items and the bytes they point into stay untouched.
+ */
+
+typedef struct chunk_slot_s {
+  size_t len;
+  bool restart; /* first bytes after the followed file was truncated */
+  uint8_t data[PIPELINE_CHUNK_SIZE];
+} chunk_slot_t;
+
+typedef struct packet_slot_s {
+  klv_ctx_t *ctx; /* decoded items of one packet; owned by the slot for the whole run */
+  bool restart;   /* first packet after the followed file was truncated */
+} packet_slot_t;
+
+typedef struct pipeline_s {
+  FILE *in;
+  const char *follow; /* path of in when following it */
+  klv_writer_t writer;
+  spsc_ring_t chunks;
+  spsc_ring_t packets;
+  bool reorder;
+  klv_reorder_t held;  /* packets held back for reordering, as klv_ctx_t pointers */
+  klv_ctx_t **spares;  /* contexts to swap into the slots of held packets */
+  size_t num_spares;
+  uint64_t packet_time; /* time stamp of the last packet that had one */
+  const struct klv_tag_desc_s *tags; /* ST0601 tags of the stream's version, once a slot has seen it */
+  bool not_klv;   /* the input is an archive or MP4 file, which is not streamed */
+  bool restarted; /* decoder only: the next packet slot is the first after a truncation */
+  klv_dedup_t *dedup;       /* shared by the slot contexts, or NULL */
+  klv_decimate_t *decimate; /* shared by the slot contexts, or NULL */
+} pipeline_t;
+
+static atomic_bool stop_requested;
+
+/*****************************************************************************
+ * klv_pipeline_stop
+ *
+ * Ask a pipeline that follows its input to stop at the end of what it has
+ * read. Safe to call from a signal handler.
+ *****************************************************************************/
+void klv_pipeline_stop(void) {
+  atomic_store(&stop_requested, true);
+}
+
+/*****************************************************************************
+ * follow_wait
+ *
+ * At the end of a followed file: wait until it may have grown. Returns 1
+ * when it was truncated and is read again from its start, -1 once it has
+ * been removed and fully read, or a stop was requested.
+ * watch is an inotify descriptor on the file, or -1 to only poll its size.
+ *****************************************************************************/
+static int follow_wait(pipeline_t *pipeline, int fd, int watch) {
+  struct stat st;
+
+  if (fstat(fd, &st) < 0 || st.st_nlink == 0)
+    return -1; /* removed, and nothing is left to read */
+
+  while (!atomic_load(&stop_requested)) {
+#if defined(HAVE_SYS_INOTIFY_H)
+    if (watch >= 0) {
+      struct pollfd pfd = {.fd = watch, .events = POLLIN};
+      char events[4096];
+      if (poll(&pfd, 1, PIPELINE_FOLLOW_POLL_MS) > 0 && read(watch, events, sizeof(events)) < 0 && errno != EAGAIN)
+        return -1;
+    } else
+#endif
+    {
+      (void)watch;
+      thrd_sleep(&(struct timespec){.tv_nsec = PIPELINE_FOLLOW_POLL_MS * 1000000L}, NULL);
+    }
+
+    /* decided from the file itself, so an event that was missed only delays the next read */
+    if (fstat(fd, &st) < 0)
+      return -1;
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (st.st_size < offset) { /* truncated and rewritten: start over */
+      fprintf(stderr, "%s: file truncated\n", pipeline->follow);
+      lseek(fd, 0, SEEK_SET);
+      return 1;
+    }
+    if (st.st_size > offset || st.st_nlink == 0)
+      return 0;
+  }
+  return -1;
+}
+
+/*****************************************************************************
+ * reader_main
+ *****************************************************************************/
+static int reader_main(void *arg) {
+  pipeline_t *pipeline = (pipeline_t *)arg;
+  int fd = fileno(pipeline->in);
+  int watch = -1;
+  bool restart = false;
+
+#if defined(HAVE_SYS_INOTIFY_H)
+  /* watch before the first read, so bytes appended after it always raise an event */
+  if (pipeline->follow != NULL && (watch = inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) >= 0 &&
+      inotify_add_watch(watch, pipeline->follow, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF) < 0) {
+    close(watch);
+    watch = -1;
+  }
+#endif
+
+  while (pipeline->follow == NULL || !atomic_load(&stop_requested)) {
+    chunk_slot_t *chunk = (chunk_slot_t *)spsc_ring_wait_write_slot(&pipeline->chunks);
+    /* read() rather than fread() so a live source is forwarded as soon as bytes arrive */
+    ssize_t n = read(fd, chunk->data, sizeof(chunk->data));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n == 0 && pipeline->follow != NULL) {
+      int waited = follow_wait(pipeline, fd, watch);
+      restart |= (waited == 1);
+      if (waited >= 0)
+        continue;
+    }
+    if (n <= 0)
+      break;
+    chunk->len = (size_t)n;
+    chunk->restart = restart;
+    restart = false;
+    spsc_ring_commit(&pipeline->chunks);
+  }
+
+#if defined(HAVE_SYS_INOTIFY_H)
+  if (watch >= 0)
+    close(watch);
+#endif
+  spsc_ring_close(&pipeline->chunks);
+  return 0;
+}
+
+/*****************************************************************************
+ * decode_packets
+ *
+ * Decode every complete packet in data into packet slots. Returns the number
+ * of leading bytes that are no longer needed.
+ *****************************************************************************/
+static size_t decode_packets(pipeline_t *pipeline, uint8_t *data, size_t size) {
+  size_t offset = 0;
+  size_t start = 0;
+  size_t len = 0;
+
+  while (libklv_frame_packet(data + offset, size - offset, &start, &len)) {
+    packet_slot_t *slot = (packet_slot_t *)spsc_ring_wait_write_slot(&pipeline->packets);
+    libklv_update_ctx_buffer(slot->ctx, data + offset + start, len);
+    /* the slots take turns on one stream, which names its version once */
+    if (pipeline->tags != NULL) {
+      slot->ctx->tags = pipeline->tags;
+      slot->ctx->version_seen = true;
+    } else {
+      libklv_set_version(slot->ctx, -1);
+    }
+    libklv_parse_data(slot->ctx);
+    if (pipeline->tags == NULL && slot->ctx->version_seen)
+      pipeline->tags = slot->ctx->tags;
+    slot->restart = pipeline->restarted;
+    pipeline->restarted = false;
+    spsc_ring_commit(&pipeline->packets);
+    offset += start + len;
+  }
+
+  return offset + start;
+}
+
+/*****************************************************************************
+ * decoder_main
+ *****************************************************************************/
+static int decoder_main(void *arg) {
+  pipeline_t *pipeline = (pipeline_t *)arg;
+  /* holds at most one incomplete packet plus the chunk appended to it */
+  uint8_t *pending = (uint8_t *)malloc(LIBKLV_MAX_PACKET_SIZE + 32 + PIPELINE_CHUNK_SIZE);
+  size_t pending_len = 0;
+  bool first = true;
+  chunk_slot_t *chunk;
+
+  while (pending != NULL && (chunk = (chunk_slot_t *)spsc_ring_wait_read_slot(&pipeline->chunks)) != NULL) {
+    uint8_t *data = chunk->data;
+    size_t size = chunk->len;
+
+    if (chunk->restart) { /* a new file: neither its bytes, its version nor its time stamps continue the old one */
+      pending_len = 0;
+      pipeline->tags = NULL;
+      first = true;
+      pipeline->restarted = true;
+      if (pipeline->dedup != NULL)
+        libklv_dedup_reset(pipeline->dedup);
+      if (pipeline->decimate != NULL)
+        libklv_decimate_reset(pipeline->decimate);
+    }
+    if (first && (libklv_is_archive(data, size) || libklv_is_mp4(data, size))) {
+      pipeline->not_klv = true;
+      klv_pipeline_stop(); /* a followed file would otherwise be read on forever */
+      break;
+    }
+    first = false;
+    if (pending_len > 0) { /* complete the packet left over from earlier chunks */
+      memcpy(pending + pending_len, chunk->data, chunk->len);
+      pending_len += chunk->len;
+      data = pending;
+      size = pending_len;
+    }
+
+    size_t used = decode_packets(pipeline, data, size);
+    memmove(pending, data + used, size - used);
+    pending_len = size - used;
+
+    spsc_ring_release(&pipeline->chunks);
+  }
+
+  if (pipeline->not_klv)
+    spsc_ring_release(&pipeline->chunks);
+  while ((pending == NULL || pipeline->not_klv) && spsc_ring_wait_read_slot(&pipeline->chunks) != NULL)
+    spsc_ring_release(&pipeline->chunks); /* out of memory or not KLV: keep the reader from blocking */
+
+  free(pending);
+  spsc_ring_close(&pipeline->packets);
+  return 0;
+}
+
+/*****************************************************************************
+ * write_ctx
+ *****************************************************************************/
+static void write_ctx(pipeline_t *pipeline, klv_ctx_t *ctx) {
+  struct list_head *items = &ctx->klv_items.list;
+  if (!list_empty(items))
+    libklv_write_packet(&pipeline->writer, items->next, items);
+}
+
+/*****************************************************************************
+ * release_held
+ *
+ * Write the held packets that are due, or all of them when flushing.
+ *****************************************************************************/
+static void release_held(pipeline_t *pipeline, bool flush) {
+  klv_ctx_t *ctx;
+
+  while ((ctx = (klv_ctx_t *)libklv_reorder_pop(&pipeline->held, flush)) != NULL) {
+    write_ctx(pipeline, ctx);
+    pipeline->spares[pipeline->num_spares++] = ctx;
+  }
+}
+
+/*****************************************************************************
+ * hold_slot
+ *
+ * Take the packet of slot into the reorder buffer, swapping a spare context
+ * into the slot. Late packets stay in the slot and are not written.
+ *****************************************************************************/
+static void hold_slot(pipeline_t *pipeline, packet_slot_t *slot) {
+  struct list_head *items = &slot->ctx->klv_items.list;
+
+  if (list_empty(items))
+    return;
+  libklv_packet_time(items->next, items, &pipeline->packet_time); /* without one, a packet keeps its predecessor's */
+
+  /* a full buffer releases a packet after every push, so there is always room and a spare */
+  if (libklv_reorder_push(&pipeline->held, pipeline->packet_time, slot->ctx) == 0)
+    slot->ctx = pipeline->spares[--pipeline->num_spares];
+  release_held(pipeline, false);
+}
+
+/*****************************************************************************
+ * writer_main
+ *****************************************************************************/
+static int writer_main(void *arg) {
+  pipeline_t *pipeline = (pipeline_t *)arg;
+  packet_slot_t *slot;
+
+  while ((slot = (packet_slot_t *)spsc_ring_wait_read_slot(&pipeline->packets)) != NULL) {
+    if (pipeline->reorder && slot->restart) { /* the new file's time stamps are not ordered after the old one's */
+      release_held(pipeline, true);
+      libklv_reorder_reset(&pipeline->held);
+      pipeline->packet_time = 0;
+    }
+    if (pipeline->reorder)
+      hold_slot(pipeline, slot);
+    else
+      write_ctx(pipeline, slot->ctx);
+    spsc_ring_release(&pipeline->packets);
+    if (pipeline->follow != NULL && spsc_ring_read_slot(&pipeline->packets) == NULL)
+      libklv_writer_flush(&pipeline->writer); /* caught up: hand the packets on now rather than when the buffer fills */
+  }
+
+  if (pipeline->reorder)
+    release_held(pipeline, true);
+  libklv_writer_finish(&pipeline->writer);
+  fflush(pipeline->writer.out);
+  return 0;
+}
+
+/*****************************************************************************
+ * print_ring_stats
+ *****************************************************************************/
+static void print_ring_stats(const char *name, const spsc_ring_t *ring) {
+  fprintf(stderr, "pipeline %s: %" PRIu64 " slots, producer stalled %" PRIu64 "x, consumer starved %" PRIu64 "x, max depth %zu/%zu\n",
+          name, ring->commits, ring->full_waits, ring->empty_waits, ring->max_depth, ring->mask + 1);
+}
+
+/*****************************************************************************
+ * new_slot_ctx
+ *****************************************************************************/
+static klv_ctx_t *new_slot_ctx(const klv_pipeline_options_t *options) {
+  klv_ctx_t *ctx = libklv_init();
+  if (ctx == NULL)
+    return NULL;
+  libklv_set_output(ctx, NULL, LIBKLV_OUTPUT_NONE);
+  ctx->filter = options->filter;
+  ctx->dedup = options->dedup; /* shared by all slots, which only the decoder thread parses */
+  ctx->decimate = options->decimate;
+  return ctx;
+}
+
+/*****************************************************************************
+ * klv_pipeline_run
+ *****************************************************************************/
+int klv_pipeline_run(FILE *in, FILE *out, const klv_pipeline_options_t *options) {
+  pipeline_t pipeline;
+  thrd_t reader, decoder, writer;
+  int ret = -1;
+
+  memset(&pipeline, 0, sizeof(pipeline));
+  pipeline.in = in;
+  pipeline.follow = options->follow;
+  pipeline.writer.out = out;
+  pipeline.writer.format = (uint8_t)options->format;
+  pipeline.writer.aggregate = options->aggregate;
+  pipeline.writer.publish = options->publish;
+  pipeline.reorder = options->reorder;
+  pipeline.dedup = options->dedup;
+  pipeline.decimate = options->decimate;
+
+  if (spsc_ring_init(&pipeline.chunks, PIPELINE_CHUNK_SLOTS, sizeof(chunk_slot_t)) < 0)
+    return -1;
+  if (spsc_ring_init(&pipeline.packets, PIPELINE_PACKET_SLOTS, sizeof(packet_slot_t)) < 0)
+    goto free_chunks;
+
+  for (size_t i = 0; i <= pipeline.packets.mask; i++) {
+    packet_slot_t *slot = (packet_slot_t *)spsc_ring_slot(&pipeline.packets, i);
+    if ((slot->ctx = new_slot_ctx(options)) == NULL)
+      goto free_packets;
+  }
+
+  if (pipeline.reorder) {
+    if (libklv_reorder_init(&pipeline.held, options->reorder_window, PIPELINE_REORDER_SLOTS) < 0)
+      goto free_packets;
+    pipeline.spares = (klv_ctx_t **)calloc(PIPELINE_REORDER_SLOTS, sizeof(klv_ctx_t *));
+    if (pipeline.spares == NULL)
+      goto free_packets;
+    for (; pipeline.num_spares < PIPELINE_REORDER_SLOTS; pipeline.num_spares++) {
+      if ((pipeline.spares[pipeline.num_spares] = new_slot_ctx(options)) == NULL)
+        goto free_packets;
+    }
+  }
+
+  /* start from the end of the pipeline so a failure can always be unwound by closing rings */
+  if (thrd_create(&writer, writer_main, &pipeline) != thrd_success)
+    goto free_packets;
+  if (thrd_create(&decoder, decoder_main, &pipeline) != thrd_success) {
+    spsc_ring_close(&pipeline.packets);
+    thrd_join(writer, NULL);
+    goto free_packets;
+  }
+  if (thrd_create(&reader, reader_main, &pipeline) != thrd_success) {
+    spsc_ring_close(&pipeline.chunks);
+    thrd_join(decoder, NULL);
+    thrd_join(writer, NULL);
+    goto free_packets;
+  }
+  thrd_join(reader, NULL);
+  thrd_join(decoder, NULL);
+  thrd_join(writer, NULL);
+
+  if (pipeline.not_klv) {
+    fprintf(stderr, "Archive and MP4 input cannot be streamed; decode it without --pipeline, --reorder or --follow\n");
+    goto free_packets;
+  }
+  print_ring_stats("read", &pipeline.chunks);
+  print_ring_stats("decode", &pipeline.packets);
+  if (pipeline.reorder)
+    fprintf(stderr, "pipeline reorder: %" PRIu64 " late packets dropped\n", pipeline.held.late);
+  if (options->dedup != NULL)
+    fprintf(stderr, "pipeline dedup: %" PRIu64 " duplicate packets dropped\n", options->dedup->duplicates);
+  if (options->decimate != NULL)
+    fprintf(stderr, "pipeline decimate: %" PRIu64 " packets kept, %" PRIu64 " dropped\n", options->decimate->kept, options->decimate->dropped);
+  ret = 0;
+
+free_packets:
+  for (size_t i = 0; i < pipeline.num_spares; i++)
+    libklv_cleanup(pipeline.spares[i]);
+  free(pipeline.spares);
+  libklv_reorder_cleanup(&pipeline.held);
+  for (size_t i = 0; i <= pipeline.packets.mask; i++)
+    libklv_cleanup(((packet_slot_t *)spsc_ring_slot(&pipeline.packets, i))->ctx);
+  spsc_ring_free(&pipeline.packets);
+free_chunks:
+  spsc_ring_free(&pipeline.chunks);
+  return ret;
+}
@@ -0,0 +1,42 @@
+/**
+ * klv_pipeline.h: reader/decoder/writer threads connected by SPSC rings
+ * @author Kongsberg Geospatial Ltd.
+ * @author www.kongsberggeospatial.com
+ * @copyright 2022 Kongsberg Geospatial Ltd.
+ */
+
+#ifndef KLV_PIPELINE_H_INCLUDED
+#define KLV_PIPELINE_H_INCLUDED
+
+#include <stdio.h>
+
+#include "libklv/libklv.h"
+#include "libklv/libklv_aggregate.h"
+#include "libklv/libklv_decimate.h"
+#include "libklv/libklv_dedup.h"
+#include "libklv/libklv_filter.h"
+#include "libklv/libklv_publish.h"
+#include "libklv/libklv_reorder.h"
+
+#define PIPELINE_CHUNK_SIZE 65536 /* bytes per read from the input */
+#define PIPELINE_CHUNK_SLOTS 16   /* buffered reads between the reader and the decoder */
+#define PIPELINE_PACKET_SLOTS 1024 /* decoded packets between the decoder and the writer */
+#define PIPELINE_FOLLOW_POLL_MS 100 /* longest wait for new data before checking for a stop request */
+#define PIPELINE_REORDER_SLOTS 4096 /* most packets held back to be put in time stamp order */
+
+typedef struct klv_pipeline_options_s {
+  klv_output_format_t format;  /* output format */
+  klv_aggregate_t *aggregate;  /* when set, packets are summarized per window instead of written */
+  const klv_filter_t *filter;  /* packets to keep, NULL for all */
+  klv_dedup_t *dedup;          /* when set, copies of recent packets are dropped before decoding */
+  klv_decimate_t *decimate;    /* when set, the stream is thinned out before decoding */
+  klv_publish_t *publish;      /* when set, the latest state is also published */
+  const char *follow;          /* path of the input, to wait for it to grow at its end instead of stopping */
+  bool reorder;                /* write packets in time stamp order, dropping those later than reorder_window */
+  uint64_t reorder_window;     /* microseconds of stream time a packet is held for earlier ones to arrive */
+} klv_pipeline_options_t;
+
+int klv_pipeline_run(FILE *in, FILE *out, const klv_pipeline_options_t *options);
+void klv_pipeline_stop(void);
+
+#endif // KLV_PIPELINE_H_INCLUDED
@@ -1,21 +1,26 @@
 #include "libklv.h"
+#include "libklv_decimate.h"
+#include "libklv_dedup.h"
+#include "libklv_filter.h"
+#include "libklv_tags.h"
 #include <float.h>
 #include <stdint.h>
-#include <time.h>
 #include <inttypes.h>
 
 /*
  * Local prototypes
  */
 static uint64_t klv_get_ber_length(klv_ctx_t *p);
-static int decode_klv_values(klv_item_t *item, klv_ctx_t *klv_ctx, uint64_t *current_klv_start);
+static int decode_klv_values(klv_item_t *item, const klv_tag_desc_t *desc, klv_ctx_t *klv_ctx);
 static double libklv_map_val(double value, double a, double b, double targetA, double targetB);
 static int sync_to_klv_key(klv_ctx_t *klv_ctx);
 static inline uint64_t libklv_readUINT64(klv_ctx_t *p);
 static inline uint32_t libklv_readUINT32(klv_ctx_t *p);
 static inline uint16_t libklv_readUINT16(klv_ctx_t *p);
 static inline uint8_t libklv_readUINT8(klv_ctx_t *p);
-static char *libklv_strdup(klv_ctx_t *src, uint8_t len);
+static void *libklv_item_reserve(klv_item_t *item, size_t size);
+static char *libklv_read_str(klv_item_t *item, klv_ctx_t *src, uint8_t len);
+static char *libklv_set_str(klv_item_t *item, const char *str);
 static bool has_valid_checksum(const klv_ctx_t *ctx, uint64_t offset, uint64_t len);
 
 /*****************************************************************************
@@ -115,10 +120,32 @@ static double libklv_map_val(double value, double a, double b, double targetA, d
 }
 
 /*****************************************************************************
- * libklv_strdup
+ * libklv_item_reserve
+ *
+ * Point item->data at a buffer of at least size bytes. The backing storage
+ * survives recycling, so steady-state parsing only grows it, never frees it.
  *****************************************************************************/
-static char *libklv_strdup(klv_ctx_t *src, uint8_t len) {
-  char *tmp = (char *)malloc(len + 1); /* allocate extra byte for null-terminator */
+static void *libklv_item_reserve(klv_item_t *item, size_t size) {
+  if (size > item->storage_size) {
+    void *tmp = realloc(item->storage, size);
+    if (tmp == NULL)
+      return NULL;
+    item->storage = tmp;
+    item->storage_size = size;
+  }
+  item->data = item->storage;
+  return item->data;
+}
+
+/*****************************************************************************
+ * libklv_read_str
+ *****************************************************************************/
+static char *libklv_read_str(klv_item_t *item, klv_ctx_t *src, uint8_t len) {
+  char *tmp = (char *)libklv_item_reserve(item, len + 1); /* allocate extra byte for null-terminator */
+  if (tmp == NULL) {
+    src->buf_ptr += len;
+    return NULL;
+  }
   for (int i = 0; i < len; i++)
     tmp[i] = *src->buf_ptr++;
   tmp[len] = '\0';
@@ -126,672 +153,120 @@ static char *libklv_strdup(klv_ctx_t *src, uint8_t len) {
 }
 
 /*****************************************************************************
- * decode_klv_values
+ * libklv_set_str
  *****************************************************************************/
-static int decode_klv_values(klv_item_t *item, klv_ctx_t *klv_ctx, uint64_t *current_klv_start) {
-  uint8_t stn_num;
-  uint8_t substn_num;
-  uint8_t wpn_type;
-  uint8_t wpn_var;
-
-  switch (item->id) {
-  case 0x01: /* misb std 0601 checksum */
-    item->value = libklv_readUINT16(klv_ctx);
-    klv_ctx->checksum = (uint16_t)item->value;
-    printf("\"%d\": [\"checksum\", \"%" PRIu64 "\"]", item->id, item->value);
-    printf("}\n");
+static char *libklv_set_str(klv_item_t *item, const char *str) {
+  size_t len = strlen(str);
+  char *tmp = (char *)libklv_item_reserve(item, len + 1);
+  if (tmp != NULL)
+    memcpy(tmp, str, len + 1);
+  return tmp;
+}
 
-    // Get the start and end addresses of a sub-packet inside a KLV packet
-    uint8_t *last_index = (klv_ctx->buf_ptr);
-    uint8_t *start_of_klv = &klv_ctx->buffer[*current_klv_start];
+/*****************************************************************************
+ * libklv_read_uint
+ *****************************************************************************/
+static inline uint64_t libklv_read_uint(klv_ctx_t *p, uint8_t len) {
+  switch (len) {
+  case 1:
+    return libklv_readUINT8(p);
+  case 2:
+    return libklv_readUINT16(p);
+  case 4:
+    return libklv_readUINT32(p);
+  default:
+    return libklv_readUINT64(p);
+  }
+}
 
-    // Calculate the length of this sub-packet
-    uint64_t len = (uint64_t)last_index - (uint64_t)start_of_klv;
+/*****************************************************************************
+ * libklv_read_int
+ *****************************************************************************/
+static inline int64_t libklv_read_int(klv_ctx_t *p, uint8_t len) {
+  switch (len) {
+  case 1:
+    return libklv_readINT8(p);
+  case 2:
+    return libklv_readINT16(p);
+  default:
+    return libklv_readINT32(p);
+  }
+}
 
-    // Run a checksum on the subpacket to verify integrity
-    if (has_valid_checksum(klv_ctx, *current_klv_start, len) == false) {
-      fprintf(stderr, "Invalid checksum\n");
-    } else {
-      fprintf(stderr, "Valid Checksum!\n");
-    }
-    if (sync_to_klv_key(klv_ctx) < 0) {
-      return -1;
-    }
-    *current_klv_start += len;
-    klv_ctx->payload_len = klv_get_ber_length(klv_ctx);
-    if (klv_ctx->buf_ptr < klv_ctx->buf_end) {
-      printf("{");
-    }
-    break;
-  case 0x02: /* unix time stamp */
-             /* microseconds since 00:00:00:00, January 1st 1970 */
-    {
-      item->value = libklv_readUINT64(klv_ctx);
-
-      // Format as ISO8601 Date String
-      struct timespec ts;
-      // Extract milliseconds from date
-      timespec_get(&ts, TIME_UTC);
-      uint16_t milliseconds = (uint16_t)((item->value % 1000000) / 1000);
-      ts.tv_sec = item->value / 1000000;
-      ts.tv_nsec = milliseconds * 1000000;
-
-      char time_string[ISO_STRING_LEN - 4];
-      strftime(time_string, ISO_STRING_LEN - 4, "%FT%T", gmtime(&ts.tv_sec));
-
-      printf("\"%d\": [\"unix epoch\", \"%s.%dZ\"], ", item->id, time_string, milliseconds);
-    }
-    break;
-  case 0x03: /* mission id */
-    item->data = libklv_strdup(klv_ctx, item->len);
-    printf("\"%d\": [\"mission id\", \"%s\"], ", item->id, (char *)item->data);
-    break;
-  case 0x04: /* platform tail number */
-    item->data = libklv_strdup(klv_ctx, item->len);
-    printf("\"%d\": [\"tail number\", \"%s\"], ", item->id, (char *)item->data);
-    break;
-  case 0x05: /* platform heading angle */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..360 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 360.0);
-    printf("\"%d\": [\"platform heading ang\", \"%.15f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x06: /* platform pitch angle */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-20 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -20.0, 20.0);
-    printf("\"%d\": [\"platform pitch angle\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x07: /* platform roll angle */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-50 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -50.0, 50.0);
-    printf("\"%d\": [\"platform roll angle\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x08: /* platform true airspeed */
-    /* 0..255 */
-    item->value = libklv_readUINT8(klv_ctx);
-    printf("\"%d\": [\"platform true airspeed\", \"%" PRIu64 "\"], ", item->id, item->value);
-    break;
-  case 0x09: /* platform indicated airspeed */
-    /* 0..255 */
-    item->value = libklv_readUINT8(klv_ctx);
-    printf("\"%d\": [\"platform indicated speed\", \"%" PRIu64 "\"], ", item->id, item->value);
-    break;
-  case 0x0A: /* platform designation */
-    item->data = libklv_strdup(klv_ctx, item->len);
-    printf("\"%d\": [\"platform designation\", \"%s\"], ", item->id, (char *)item->data);
-    break;
-  case 0x0B: /* image source sensor */
-    item->data = libklv_strdup(klv_ctx, item->len);
-    printf("\"%d\": [\"image source sensor\", \"%s\"], ", item->id, (char *)item->data);
-    break;
-  case 0x0C: /* image coordinate system */
-    item->data = libklv_strdup(klv_ctx, item->len);
-    printf("\"%d\": [\"coordinate system\", \"%s\"], ", item->id, (char *)item->data);
-    break;
-  case 0x0D: /* sensor latitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"sensor latitude\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x0E: /* sensor longitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"sensor longitude\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x0F: /* sensor true altitude */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19,000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"sensor true altitude\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x10: /* sensor horizontal field of view */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..180 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 180.0);
-    printf("\"%d\": [\"sensor horizontal FOV\", \"%.15f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x11: /* sensor vertical field of view */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..180 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 180.0);
-    printf("\"%d\": [\"sensor vertical FOV\", \"%.15f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x12: /* sensor relative azimuth angle */
-    item->value = libklv_readUINT32(klv_ctx);
-    /* Map 0..(2^32-1) to 0..360 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT32_MAX, 0.0, 360.0);
-    printf("\"%d\": [\"sensor rel az ang\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x13: /* sensor relative elevation angle */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"sensor rel elev ang\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x14: /* sensor relative roll angle */
-    item->value = libklv_readUINT32(klv_ctx);
-    /* Map 0..(2^32-1) to 0..360 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"sensor rel roll ang\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x15: /* slant range */
-    item->value = libklv_readUINT32(klv_ctx);
-    /* Map 0..(2^32-1) to 0..5000,000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT32_MAX, 0.0, 5000000.0);
-    printf("\"%d\": [\"slant range\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x16: /* target width */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..10000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 10000.0);
-    printf("\"%d\": [\"target width\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x17: /* frame center latitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"frame center lat\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x18: /* frame center longitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"frame center lon\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x19: /* frame center elevation */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19,000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"frame center elev\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x1A: /* offset corner lat pt.1 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lat 1\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x1B: /* offset corner lon pt.1 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lon 1\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x1C: /* offset corner lat pt.2 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lat 2\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x1D: /* offset corner lon pt.2 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lon 2\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x1E: /* offset corner lat pt.3 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lat 3\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x1F: /* offset corner lon pt.3 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lon 3\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x20: /* offset corner lat pt.4 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lat 4\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x21: /* offset corner lon pt.4 */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-0.075 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
-    printf("\"%d\": [\"offset crnr lon 4\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x22: /* icing detected */
-    printf("\"%d\": [\"icing detected\", \"", item->id);
-    item->value = libklv_readUINT8(klv_ctx);
-    switch (item->value) {
-    case 0:
-      item->data = strdup("detector off");
-      break;
-    case 1:
-      item->data = strdup("no icing detected");
-      break;
-    case 2:
-      item->data = strdup("icing detected");
-      break;
-    default:
-      item->data = strdup("unsupported value");
+/*****************************************************************************
+ * decode_klv_values
+ *
+ * Width, signedness, mapped range and value names come from desc, the entry
+ * of the stream's tag table, so one pass serves every ST0601 version.
+ *****************************************************************************/
+static int decode_klv_values(klv_item_t *item, const klv_tag_desc_t *desc, klv_ctx_t *klv_ctx) {
+  switch (desc->type) {
+  case KLV_TYPE_UINT:
+    item->value = libklv_read_uint(klv_ctx, desc->len);
+    /* Map 0..(2^n-1) to min..max */
+    if (desc->min < desc->max)
+      item->mapped_val = libklv_map_val((double)item->value, 0, (double)(UINT64_MAX >> (64 - 8 * desc->len)), desc->min, desc->max);
+    /* enumerations are named by their value */
+    if (desc->num_values > 0) {
+      const char *value_name = desc->values[(item->value < desc->num_values) ? item->value : desc->num_values];
+      if (value_name != NULL)
+        libklv_set_str(item, value_name);
     }
     break;
-  case 0x23: /* wind direction */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..360*/
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 360.0);
-    printf("\"%d\": [\"wind direction\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x24: /* wind speed */
-    item->value = libklv_readUINT8(klv_ctx);
-    /* Map 0..255 to 0..100*/
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 360.0);
-    printf("\"%d\": [\"wind speed\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x25: /* static pressure */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..5,000 mbar*/
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 5000.0);
-    printf("\"%d\": [\"static pressure (mbar)\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x26: /* density altitude */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19000*/
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"density altitude\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x27: /* outside air temperature */
-    item->signed_val = libklv_readINT8(klv_ctx);
-    printf("\"%d\": [\"outside air temp\", \"%"PRId64"\"], ", item->id, item->signed_val);
-    break;
-  case 0x28: /* target location latitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"target location lat\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x29: /* target location longitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"target location lon\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x2A: /* target location elevation */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"target location elev\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x2B: /* target track gate width */
-    item->value = libklv_readUINT8(klv_ctx);
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT8_MAX, 0, 512);
-    printf("\"%d\": [\"target track gate wdth\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x2C: /* target track gate height */
-    item->value = libklv_readUINT8(klv_ctx);
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT8_MAX, 0, 512);
-    printf("\"%d\": [\"target track gate ht.\", \"%.14f\"], ", item->id, item->mapped_val);
+  case KLV_TYPE_INT: {
+    double raw_max = (double)(INT64_MAX >> (64 - 8 * desc->len));
+    item->signed_val = libklv_read_int(klv_ctx, desc->len);
+    /* Map -(2^(n-1)-1)..(2^(n-1)-1) to min..max */
+    if (desc->min < desc->max)
+      item->mapped_val = libklv_map_val((double)item->signed_val, -raw_max, raw_max, desc->min, desc->max);
     break;
-  case 0x2D: /* target error estimate CE90 */
-    item->value = libklv_readUINT16(klv_ctx);
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0, 4095);
-    printf("\"%d\": [\"target err est. CE90\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x2E: /* target error estimate LE90 */
-    item->value = libklv_readUINT16(klv_ctx);
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0, 4095);
-    printf("\"%d\": [\"target err est. LE90\", \"%.14f\"], ", item->id, item->mapped_val);
+  }
+  case KLV_TYPE_STRING:
+    libklv_read_str(item, klv_ctx, item->len);
     break;
-  case 0x2F: /* generic flag data 01 */
-    item->value = libklv_readUINT8(klv_ctx);
-    printf("\"%d\": [\"generic flag data 01\", {\"Laser Range\": \"%" PRIu64 "\",", item->id, (item->value & 0x01));
-    printf("\"Auto_Track\": \"%" PRIu64 "\",", (item->value & 0x02));
-    printf("\"IR_Polarity\": \"%" PRIu64 "\",", (item->value & 0x04));
-    printf("\"Icing_detected\": \"%" PRIu64 "\",", (item->value & 0x08));
-    printf("\"Slant_Range\": \"%" PRIu64 "\",", (item->value & 0x10));
-    printf("\"Image_Invalid\": \"%" PRIu64 "\"", (item->value & 0x20));
-    printf("}], ");
+  case KLV_TYPE_BYTES:
+    break; /* kept by the tags below that are decoded at all */
+  default:
+    if (klv_ctx->report != NULL)
+      klv_ctx->report(klv_ctx->report_user, LIBKLV_REPORT_KEY_NOT_HANDLED, item->id);
+    return item->len;
+  }
+
+  /* tags that mean more than their number */
+  switch (item->id) {
+  case 0x01: /* misb std 0601 checksum */
+    klv_ctx->checksum = (uint16_t)item->value;
     break;
   case 0x30: /* security local metadata set */
-    item->data = malloc(item->len);
-    libklv_read(item->data, klv_ctx, item->len);
-    printf("\"%d\": [\"sec local metadata set\", \"set size=%d\"], ", item->id, item->len);
-    break;
-  case 0x31: /* differential pressure */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..-(2^16-1) to 0..5000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 5000.0);
-    printf("\"%d\": [\"differential pressure\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x32: /* platform angle of attack */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-20 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -20.0, 20.0);
-    printf("\"%d\": [\"platform angle of atk\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x33: /* platform vertical speed */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"platform vert speed\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x34: /* platform slideslip angle */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to +/-20 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -20.0, 20.0);
-    printf("\"%d\": [\"platform slideslip ang\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x35: /* airfieled barometric pressure */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..5,000 mbar*/
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 5000.0);
-    printf("\"%d\": [\"airfield pressure\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x36: /* airfieled elevation */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19,000 mbar*/
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"airfield elev\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x37: /* relative humidity */
-    item->value = libklv_readUINT8(klv_ctx);
-    /* Map 0..(2^8-1) to 0..100 */
-    item->mapped_val = libklv_map_val((double)item->value, 0.0, 255.0, 0.0, 100.0);
-    printf("\"%d\": [\"relative humidity\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x38: /* platform ground speed */
-    /* 0..255 */
-    item->value = libklv_readUINT8(klv_ctx);
-    printf("\"%d\": [\"platform gnd speed\", \"%" PRIu64 "\"], ", item->id, item->value);
-    break;
-  case 0x39: /* ground range */
-    item->value = libklv_readUINT32(klv_ctx);
-    /* Map 0..(2^32-1) to 0..5000000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT32_MAX, 0.0, 5000000.0);
-    printf("\"%d\": [\"ground range\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x3A: /* platform fuel remaining */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..10000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 10000.0);
-    printf("\"%d\": [\"platform fuel remain\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x3B: /* platform call sign */
-    item->data = libklv_strdup(klv_ctx, item->len);
-    printf("\"%d\": [\"platform call sign\", \"%s\"], ", item->id, (char *)item->data);
-    break;
-  case 0x3C: /* weapon load */
-    item->value = libklv_readUINT16(klv_ctx);
-    // TODO: figure out weapon variants and type names
-    /*       byte 1           byte 2
-     * +--------+--------+--------+--------+
-     * |  nib1  |  nib2  |  nib1  |  nib2  |
-     * +--------+--------+--------+--------+
-     * 32                16                1
-     *
-     * byte1 - nib1 = Station number
-     * byte1 - nib2 = Substation Number
-     * byte2 - nib1 = Weapon type
-     * byte2 - nib2 = Weapon variant
-     */
-    stn_num = (uint8_t)((item->value >> 8) - (item->value >> 12));
-    substn_num = (uint8_t)(item->value >> 8) - ((item->value >> 8) & 0x0F);
-    wpn_type = (item->value & 0x00FF) - ((item->value >> 4) & 0x0F);
-    wpn_var = (item->value & 0x00FF) - (item->value & 0x000F);
-    printf("\"%d\": [\"weapon load\", \"%d|%d|%d|%d\"], ", item->id, stn_num, substn_num, wpn_type, wpn_var);
-    break;
-  case 0x3D: /* weapon fired */
-    item->value = libklv_readUINT8(klv_ctx);
-    /* +--------+--------+
-     * |  STN # |SUBSTN #|
-     * +--------+--------+
-     * 8                 1
-     */
-    stn_num = (uint8_t)((item->value) - ((item->value >> 4) & 0x0F));
-    substn_num = (uint8_t)((item->value) - (item->value & 0x0F));
-    printf("\"%d\": [\"weapon fired\", \"%d|%d\"], ", item->id, stn_num, substn_num);
-    break;
-  case 0x3E: /* laser prf code */
-    item->value = libklv_readUINT16(klv_ctx);
-    printf("\"%d\": [\"laser prf code\", \"%" PRIu64 "\"], ", item->id, item->value);
-    break;
-  case 0x3F: /* sensor field of view name */
-    item->value = libklv_readUINT8(klv_ctx);
-    switch (item->value) {
-    case 0:
-      item->data = strdup("Ultranarrow");
-      break;
-    case 1:
-      item->data = strdup("Narrow");
-      break;
-    case 2:
-      item->data = strdup("Medium");
-      break;
-    case 3:
-      item->data = strdup("Wide");
-      break;
-    case 4:
-      item->data = strdup("Ultrawide");
-      break;
-    case 5:
-      item->data = strdup("Narrow Medium");
-      break;
-    case 6:
-      item->data = strdup("2x Ultranarrow");
-      break;
-    case 7:
-      item->data = strdup("4x Ultranarrow");
-      break;
-    }
-    printf("\"%d\": [\"sensor fov name\", \"%s", item->id, (char *)item->data);
-    break;
-  case 0x40: /* platform magnetic heading angle */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..360 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 360.0);
-    printf("\"%d\": [\"platform mag head ang\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x41: /* uas ls version number */
-    item->value = libklv_readUINT8(klv_ctx);
-    printf("\"%d\": [\"uas ls version num\", \"ST0601.%" PRIu64 "\"], ", item->id, item->value);
-    break;
-  case 0x42: /* target location covariance matrix */
-    // TODO: implement in the future. According to ST0601.8 this field is TBD
-    klv_ctx->buf_ptr += item->len;
-    break;
-  case 0x43: /* alternate platform latitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* LAT: Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"alt platfm latitude\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x44: /* alternate platform longitude */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* LAT: Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"alt platfm longitude\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x45: /* alternate platform altitude */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19,000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"alt altitude\", \"%.12f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x46: /* alternate platform name */
-    item->data = libklv_strdup(klv_ctx, item->len);
-    printf("\"%d\": [\"alt pltfrm name\", \"%s", item->id, (char *)item->data);
-    break;
-  case 0x47: /* alternate platform heading */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to 0..360 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, 0.0, 360.0);
-    printf("\"%d\": [\"alternate platform heading\", \"%.15f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x48: /* event start time */
-    item->value = libklv_readUINT64(klv_ctx);
-    printf("\"%d\": [\"event start time\", \"%" PRIu64 "\"], ", item->id, item->value);
-    break;
   case 0x49: /* rvt local set */
-    item->data = malloc(item->len);
-    libklv_read(item->data, klv_ctx, item->len);
-    printf("\"%d\": [\"rvt local set\", \"%s\"], ", item->id, (char *)item->data);
-    break;
   case 0x4A: /* vmti data set */
-    item->data = malloc(item->len);
-    libklv_read(item->data, klv_ctx, item->len);
-    const uint8_t *cp = (uint8_t *)item->data;
-    printf("\"%d\": [\"vmti data set\", \"", item->id);
-    for (uint8_t i = 0; i < item->len; i++) {
-      printf("\\\\x%02x", cp[i]);
-    }
-    printf("\"], ");
-    break;
-  case 0x4B: /* sensor ellipsoid height */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"sensor ellip ht.\", \"%.15f\"], ", item->id, item->mapped_val);
+    if (libklv_item_reserve(item, item->len) != NULL)
+      libklv_read(item->data, klv_ctx, item->len);
     break;
-  case 0x4C: /* alternate platform ellipsoid height */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"alt pltfm elpsd ht.\", \"%.15f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x4D: /* operational mode */
-    item->value = libklv_readUINT8(klv_ctx);
-    switch (item->value) {
-    case 0x00:
-      item->data = strdup("Other");
-      break;
-    case 0x01:
-      item->data = strdup("Operational");
-      break;
-    case 0x02:
-      item->data = strdup("Training");
-      break;
-    case 0x03:
-      item->data = strdup("Exercise");
-      break;
-    case 0x04:
-      item->data = strdup("Maintenance");
-      break;
-    case 0x05:
-      item->data = strdup("Test");
-      break;
-    default:
-      item->data = strdup("Unknown");
-      break;
+  case 0x41: /* uas ls version number */
+    /* the rest of the stream is read as its version defines it */
+    if (!klv_ctx->version_seen) {
+      klv_ctx->tags = libklv_tag_table((uint8_t)item->value);
+      klv_ctx->version_seen = true;
     }
-    printf("\"%d\": [\"operational mode\", \"%s", item->id, (char *)item->data);
-    break;
-  case 0x4E: /* frame center height above ellipsoid */
-    item->value = libklv_readUINT16(klv_ctx);
-    /* Map 0..(2^16-1) to -900..19000 */
-    item->mapped_val = libklv_map_val((double)item->value, 0, UINT16_MAX, -900.0, 19000.0);
-    printf("\"%d\": [\"frame center height above ellipsoid \", \"%.14f\"], ", item->id, item->mapped_val);
     break;
-  case 0x4F: /* sensor north velocity */
-    item->signed_val = libklv_readUINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to -327..327 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -327.0, 327.0);
-    printf("\"%d\": [\"sensor north velocity\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x50: /* sensor east velocity */
-    item->signed_val = libklv_readINT16(klv_ctx);
-    /* Map -(2^15-1)..(2^15-1) to -327..327 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT16_MIN + 1, INT16_MAX, -327.0, 327.0);
-    printf("\"%d\": [\"sensor east velocity\", \"%.14f\"], ", item->id, item->mapped_val);
+  case 0x42: /* target location covariance matrix */
+    // TODO: implement in the future. According to ST0601.8 this field is TBD
     break;
   case 0x51: /* image horizon pixel pack */
     // TODO: implement decoding this
-    klv_ctx->buf_ptr += item->len;
-    break;
-  case 0x52: /* corner latitude point 1 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"corner latitude point 1 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x53: /* corner longitude point 1 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"corner longitude point 1 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x54: /* corner latitude point 2 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"corner latitude point 2 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x55: /* corner longitude point 2 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"corner longitude point 2 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x56: /* corner latitude point 3 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"corner latitude point 3 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x57: /* corner longitude point 3 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"corner longitude point 3 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x58: /* corner latitude point 4 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"corner latitude point 4 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x59: /* corner longitude point 4 (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-180 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
-    printf("\"%d\": [\"corner longitude point 4 (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x5A: /* platform pitch angle (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"platform pitch angle (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x5B: /* platform roll angle (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"platform roll angle (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x5C: /* platform angle of attack (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"platform angle of attack (full)\", \"%.14f\"], ", item->id, item->mapped_val);
-    break;
-  case 0x5D: /* platform sideslip angle (full) */
-    item->signed_val = libklv_readINT32(klv_ctx);
-    /* Map -(2^31-1)..(2^31-1) to +/-90 */
-    item->mapped_val = libklv_map_val((double)item->signed_val, INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
-    printf("\"%d\": [\"platform sideslip angle (full)\", \"%.14f\"], ", item->id, item->mapped_val);
     break;
   case 0x5E: /* miis core item->identifier */
     // TODO: implement based off of ST 1204 standards document (http://www.gwg.nga.mil/)
-    klv_ctx->buf_ptr += item->len;
     break;
   case 0x5F: /* sar motion imagery metadata */
     // TODO: implement based off of ST 1206 standards document (http://www.gwg.nga.mil/)
-    klv_ctx->buf_ptr += item->len;
     break;
   case 0x60: /* target width extended */
     /* According to ST1601.9 the conversion formula is in MISB ST 1201. */
     // TODO: implement appropriate conversion
-    klv_ctx->buf_ptr += item->len;
     break;
   default:
-    fprintf(stderr, "  KEY NOT HANDLED: 0x%02X", item->id);
-    printf("\n");
     break;
   }
 
@@ -817,18 +292,71 @@ static uint64_t klv_get_ber_length(klv_ctx_t *p) {
   return size;
 }
 
+/*
+ * Universal keys of the recognized standards, at the slot of their perfect
+ * hash: byte 12 differs between them, so its low nibble picks the one key a
+ * candidate can be, and a single memcmp confirms it.
+ */
+typedef struct klv_standard_key_s {
+  uint8_t key[16];
+  int8_t standard; /* klv_standard_t */
+} klv_standard_key_t;
+
+#define KEY_SLOT(key) ((key)[12] & 0x0F)
+
+static const klv_standard_key_t standard_keys[16] = {
+    [0x01] = {{0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01, 0x0e, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00}, LIBKLV_ST0601},
+    [0x02] = {{0x06, 0x0e, 0x2b, 0x34, 0x02, 0x03, 0x01, 0x01, 0x0e, 0x01, 0x03, 0x03, 0x02, 0x00, 0x00, 0x00}, LIBKLV_ST0102},
+    [0x06] = {{0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01, 0x0e, 0x01, 0x03, 0x03, 0x06, 0x00, 0x00, 0x00}, LIBKLV_ST0903},
+    [0x0D] = {{0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01, 0x0e, 0x01, 0x03, 0x03, 0x0d, 0x00, 0x00, 0x00}, LIBKLV_ST1206},
+};
+
+/*****************************************************************************
+ * libklv_key_standard
+ *
+ * The klv_standard_t of the 16-byte universal key at key, or -1 if it is not
+ * one libklv recognizes.
+ *****************************************************************************/
+int libklv_key_standard(const uint8_t *key) {
+  const klv_standard_key_t *entry = &standard_keys[KEY_SLOT(key)];
+  if (key[0] != 0x06 || entry->key[0] != 0x06 || memcmp(key, entry->key, 16) != 0)
+    return -1;
+  return entry->standard;
+}
+
+/*****************************************************************************
+ * find_key
+ *
+ * First recognized universal key in [p, end), jumping between candidate 0x06
+ * bytes with memchr. Returns its start and sets *standard, or NULL.
+ *****************************************************************************/
+static const uint8_t *find_key(const uint8_t *p, const uint8_t *end, int *standard) {
+  while (end - p >= 16) {
+    p = (const uint8_t *)memchr(p, 0x06, (size_t)(end - p) - 15);
+    if (p == NULL)
+      return NULL;
+    if ((*standard = libklv_key_standard(p)) >= 0)
+      return p;
+    p++;
+  }
+  return NULL;
+}
+
 /*****************************************************************************
  * sync_to_klv_key
+ *
+ * Move past the next recognized universal key and return its standard.
  *****************************************************************************/
 static int sync_to_klv_key(klv_ctx_t *klv_ctx) {
-  for (int i = 0; i < klv_ctx->buffer_size; i++) {
-    if (klv_ctx->buffer[i] == klv_universal_key[0] && memcmp(klv_ctx->buffer + i, &klv_universal_key, 16) == 0) {
-      klv_ctx->buf_ptr += (i + 16); /* start of key uid + 16-byte key uid length */
-      return i;                     /* return offset to start of klv universal local set key */
-    }
-  }
+  int standard = -1;
+  const uint8_t *p = find_key(klv_ctx->buf_ptr, klv_ctx->buf_end, &standard);
 
-  return -1;
+  if (p == NULL) {
+    klv_ctx->buf_ptr = klv_ctx->buf_end;
+    return -1;
+  }
+  klv_ctx->buf_ptr = (uint8_t *)p + 16; /* start of key uid + 16-byte key uid length */
+  return standard;
 }
 
 /*****************************************************************************
@@ -840,38 +368,129 @@ static void delete_klv_item_list(klv_item_t *items) {
 
   list_for_each_safe(pos, q, &items->list) {
     p_tmp_item = list_entry(pos, klv_item_t, list);
-    if (p_tmp_item->data != NULL)
-      free(p_tmp_item->data); /* free any allocated data; typically strings */
-    list_del(pos);            /* remove from list */
-    free(p_tmp_item);         /* free memory allocation */
+    if (p_tmp_item->storage != NULL)
+      free(p_tmp_item->storage); /* free any allocated data; typically strings */
+    list_del(pos);               /* remove from list */
+    free(p_tmp_item);            /* free memory allocation */
   }
 }
 
+/*****************************************************************************
+ * libklv_new_item
+ *
+ * Take an item from the free list, falling back to the heap only while the
+ * free list is still warming up.
+ *****************************************************************************/
+static klv_item_t *libklv_new_item(klv_ctx_t *ctx) {
+  klv_item_t *item = NULL;
+
+  if (!list_empty(&ctx->free_items.list)) {
+    item = list_entry(ctx->free_items.list.next, klv_item_t, list);
+    list_del(&item->list);
+
+    void *storage = item->storage;
+    size_t storage_size = item->storage_size;
+    memset(item, 0, sizeof(klv_item_t));
+    item->storage = storage;
+    item->storage_size = storage_size;
+  } else {
+    item = (klv_item_t *)calloc(1, sizeof(klv_item_t));
+  }
+
+  return item;
+}
+
+/*****************************************************************************
+ * libklv_add_item
+ *
+ * Decode the value of one item from value[0, len) and append it to the
+ * context's item list, as libklv_parse_data does for each item of a packet,
+ * so items can be rebuilt from sources other than a KLV buffer. The item's
+ * raw pointer refers to value, which must outlive its use.
+ *****************************************************************************/
+klv_item_t *libklv_add_item(klv_ctx_t *ctx, uint8_t id, const uint8_t *value, size_t len) {
+  const klv_tag_desc_t *desc = &ctx->tags[id];
+  if (desc->type == KLV_TYPE_LATER || len < desc->len)
+    return NULL; /* not in the stream's version, or too short for the decoder's fixed-width read */
+
+  klv_item_t *item = libklv_new_item(ctx);
+  if (item == NULL)
+    return NULL;
+
+  item->id = id;
+  item->len = (uint8_t)len;
+  item->raw = value;
+  item->raw_len = len;
+
+  /* the decoder reads through buf_ptr; point it at value for the duration */
+  uint8_t *buf_ptr = ctx->buf_ptr;
+  ctx->buf_ptr = (uint8_t *)value;
+  decode_klv_values(item, desc, ctx);
+  ctx->buf_ptr = buf_ptr;
+
+  list_add_tail(&item->list, &ctx->klv_items.list);
+  return item;
+}
+
 /*****************************************************************************
  * has_valid_checksum
  *****************************************************************************/
 static bool has_valid_checksum(const klv_ctx_t *ctx, const uint64_t offset, const uint64_t len) {
+  return (libklv_checksum(&ctx->buffer[offset], len - 2) == ctx->checksum) ? true : false;
+}
+
+/*****************************************************************************
+ * libklv_checksum
+ *
+ * Running 16-bit sum of a packet, starting at the first byte of the universal
+ * key and stopping before the two checksum value bytes (len excludes them).
+ *****************************************************************************/
+uint16_t libklv_checksum(const uint8_t *packet, size_t len) {
   uint16_t bcc = 0;
-  /* sum each 16-bit chunk within the buffer into a checksum */
-  for (uint64_t i = offset; i < offset + len - 2; i++) {
-    bcc += ctx->buffer[i] << (8 * ((i + 1) % 2));
+  /* sum each 16-bit chunk within the packet into a checksum */
+  for (size_t i = 0; i < len; i++) {
+    bcc += packet[i] << (8 * ((i + 1) % 2));
   }
-  return (bcc == ctx->checksum) ? true : false;
+  return bcc;
 }
 
 /*****************************************************************************
  * libklv_update_ctx_buffer
+ *
+ * Copy src into the context's own buffer. The buffer is only reallocated
+ * when len exceeds its current capacity.
  *****************************************************************************/
 int libklv_update_ctx_buffer(klv_ctx_t *ctx, void *src, size_t len) {
-  if (ctx->buffer != NULL)
-    // TODO: reallocate buffer instead of just freeing it
-    free(ctx->buffer);
-
-  ctx->buffer = malloc(len);
+  if (len > ctx->buffer_capacity) {
+    uint8_t *tmp = (uint8_t *)realloc(ctx->owned, len);
+    if (tmp == NULL)
+      return -1;
+    ctx->owned = tmp;
+    ctx->buffer_capacity = len;
+  }
+  ctx->buffer = ctx->owned;
+  ctx->owns_buffer = true;
 
   memcpy(ctx->buffer, src, len);
 
-  ctx->buffer_size = (uint16_t)len;
+  ctx->buffer_size = len;
+  ctx->buf_end = ctx->buffer + ctx->buffer_size;
+  ctx->buf_ptr = ctx->buffer;
+
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_borrow_ctx_buffer
+ *
+ * Parse directly out of a caller-owned buffer without copying it. The caller
+ * must keep src alive and unchanged until the next buffer update or cleanup.
+ * The context's own buffer is kept for the next update.
+ *****************************************************************************/
+int libklv_borrow_ctx_buffer(klv_ctx_t *ctx, void *src, size_t len) {
+  ctx->buffer = (uint8_t *)src;
+  ctx->buffer_size = len;
+  ctx->owns_buffer = false;
   ctx->buf_end = ctx->buffer + ctx->buffer_size;
   ctx->buf_ptr = ctx->buffer;
 
@@ -882,60 +501,289 @@ int libklv_update_ctx_buffer(klv_ctx_t *ctx, void *src, size_t len) {
  * libklv_init
  *****************************************************************************/
 klv_ctx_t *libklv_init(void) {
-  klv_ctx_t *ctx = (klv_ctx_t *)malloc(sizeof(klv_ctx_t)); /* create context on heap */
+  klv_ctx_t *ctx = (klv_ctx_t *)calloc(1, sizeof(klv_ctx_t)); /* create zeroed context on heap */
+  if (ctx == NULL)
+    return NULL;
+
+  INIT_LIST_HEAD(&ctx->klv_items.list);  /* initialize the items list */
+  INIT_LIST_HEAD(&ctx->free_items.list); /* initialize the recycled items list */
 
-  INIT_LIST_HEAD(&ctx->klv_items.list); /* initialize the items list */
+  ctx->tags = libklv_tags;
+  ctx->writer.out = stdout;
+  ctx->writer.format = LIBKLV_OUTPUT_JSON;
+  ctx->report = libklv_report_to_stream;
+  ctx->report_user = stderr;
 
   return ctx;
 }
 
+/*****************************************************************************
+ * libklv_set_output
+ *
+ * Select where and how each decoded packet is written. LIBKLV_OUTPUT_NONE
+ * only decodes, leaving the items in ctx->klv_items.
+ *****************************************************************************/
+void libklv_set_output(klv_ctx_t *ctx, FILE *out, klv_output_format_t format) {
+  libklv_writer_finish(&ctx->writer);
+  ctx->writer.out = out;
+  ctx->writer.format = (uint8_t)format;
+}
+
+/*****************************************************************************
+ * libklv_set_decoder
+ *
+ * Decode the packets of one standard with decode instead of skipping them
+ * (or, for ST0601, instead of the built-in decoder). decode gets the local
+ * set payload and may add items to ctx->klv_items. NULL restores the
+ * default.
+ *****************************************************************************/
+void libklv_set_decoder(klv_ctx_t *ctx, klv_standard_t standard, klv_decode_fn decode, void *user) {
+  if ((int)standard >= 0 && standard < LIBKLV_STANDARD_COUNT) {
+    ctx->decoders[standard] = decode;
+    ctx->decoder_user[standard] = user;
+  }
+}
+
+/*****************************************************************************
+ * libklv_set_version
+ *
+ * Read ST0601 packets as UAS LS version (tag 0x41) defines them instead of
+ * choosing the version from the first version tag of the stream. A negative
+ * version goes back to choosing it, for a context that starts on a new
+ * stream. Until a version is known the newest one is assumed.
+ *****************************************************************************/
+void libklv_set_version(klv_ctx_t *ctx, int version) {
+  if (version < 0) {
+    ctx->tags = libklv_tags;
+    ctx->version_seen = false;
+    return;
+  }
+  ctx->tags = libklv_tag_table((version < UINT8_MAX) ? (uint8_t)version : UINT8_MAX);
+  ctx->version_seen = true;
+}
+
+/*****************************************************************************
+ * libklv_set_report
+ *
+ * Select who hears about checksums and unhandled keys. Everything a context
+ * reports goes through here, so contexts on different threads share no
+ * stream and no lock unless their callbacks do. NULL drops the reports.
+ *****************************************************************************/
+void libklv_set_report(klv_ctx_t *ctx, klv_report_fn report, void *user) {
+  ctx->report = report;
+  ctx->report_user = user;
+}
+
+/*****************************************************************************
+ * libklv_report_to_stream
+ *
+ * Default report callback: one line per event on the FILE * in user.
+ *****************************************************************************/
+void libklv_report_to_stream(void *user, klv_report_t report, uint8_t id) {
+  static const char *const standard_names[LIBKLV_STANDARD_COUNT] = {
+      [LIBKLV_ST0601] = "ST0601",
+      [LIBKLV_ST0102] = "ST0102",
+      [LIBKLV_ST0903] = "ST0903",
+      [LIBKLV_ST1206] = "ST1206",
+  };
+  FILE *stream = (FILE *)user;
+
+  switch (report) {
+  case LIBKLV_REPORT_CHECKSUM_VALID:
+    fputs("Valid Checksum!\n", stream);
+    break;
+  case LIBKLV_REPORT_CHECKSUM_INVALID:
+    fputs("Invalid checksum\n", stream);
+    break;
+  case LIBKLV_REPORT_KEY_NOT_HANDLED:
+    fprintf(stream, "  KEY NOT HANDLED: 0x%02X\n", id);
+    break;
+  case LIBKLV_REPORT_PACKET_NOT_HANDLED:
+    fprintf(stream, "PACKET NOT HANDLED: %s\n", (id < LIBKLV_STANDARD_COUNT) ? standard_names[id] : "unknown standard");
+    break;
+  default:
+    break;
+  }
+}
+
+/*****************************************************************************
+ * libklv_reset
+ *
+ * Recycle the parsed items and rewind to the start of the current buffer so
+ * the context can be reused without touching the heap.
+ *****************************************************************************/
+void libklv_reset(klv_ctx_t *ctx) {
+  list_splice_tail_init(&ctx->klv_items.list, &ctx->free_items.list);
+
+  ctx->buf_ptr = ctx->buffer;
+  ctx->payload_len = 0;
+  ctx->checksum = 0;
+}
+
 /*****************************************************************************
  * libklv_cleanup
  *****************************************************************************/
 void libklv_cleanup(klv_ctx_t *ctx) {
   if (ctx != NULL) {
+    libklv_writer_finish(&ctx->writer);
     delete_klv_item_list(&ctx->klv_items);
+    delete_klv_item_list(&ctx->free_items);
+    free(ctx->owned);
     free(ctx);
   }
 }
 
+/*****************************************************************************
+ * libklv_frame_packet
+ *
+ * Find the first complete packet of any recognized standard in data without
+ * decoding it, for callers that receive a stream in pieces. Returns 1 with the packet at
+ * data[*start, *start + *len). Returns 0 when no complete packet is present
+ * yet; everything before *start can then be discarded, and the rest must be
+ * kept and presented again with more data appended.
+ *****************************************************************************/
+int libklv_frame_packet(const uint8_t *data, size_t size, size_t *start, size_t *len) {
+  const uint8_t *key = data;
+  int standard;
+
+  while ((key = find_key(key, data + size, &standard)) != NULL) {
+    size_t i = (size_t)(key - data);
+    size_t pos = i + 16;
+    key++;
+    *start = i;
+    if (pos >= size)
+      return 0;
+
+    /* BER packet length, as in klv_get_ber_length */
+    uint64_t payload_len = data[pos++];
+    if (payload_len & 0x80) {
+      int bytes_num = payload_len & 0x7f;
+      if (bytes_num == 0 || bytes_num > 8)
+        continue; /* not a real packet header, keep scanning */
+      if (size - pos < (size_t)bytes_num)
+        return 0;
+      payload_len = 0;
+      while (bytes_num--)
+        payload_len = payload_len << 8 | data[pos++];
+    }
+    if (payload_len > LIBKLV_MAX_PACKET_SIZE)
+      continue;
+
+    if (size - pos < payload_len)
+      return 0;
+    *len = (pos - i) + (size_t)payload_len;
+    return 1;
+  }
+
+  /* keep a tail that could still be the beginning of a key */
+  *start = (size > 15) ? size - 15 : 0;
+  return 0;
+}
+
 /*****************************************************************************
  * libklv_parse_data
  *****************************************************************************/
 int libklv_parse_data(klv_ctx_t *klv_ctx) {
   klv_item_t *p_tmp_item = NULL; /* temporary pointer for iterating through the klv items list */
-  uint8_t bytes_read = 0;
-  uint64_t current_klv_start = 0;
+  int bytes_read = 0;
 
   /* we don't want multiple lists allocated, but we want the user to have access after a packet is parsed */
-  delete_klv_item_list(&klv_ctx->klv_items);
+  list_splice_tail_init(&klv_ctx->klv_items.list, &klv_ctx->free_items.list);
 
-  /* sync klv context with the start of klv key within the metadata packet */
-  if (sync_to_klv_key(klv_ctx) < 0) {
-    return -1;
-  }
-
-  /* packet length follows 16-byte uid */
-  // TODO: confirm this correctly reads for a short BER packet length */
-  klv_ctx->payload_len = klv_get_ber_length(klv_ctx);
+  /* sync klv context with the start of each klv key within the metadata and decode one packet at a time */
+  int standard;
+  while ((standard = sync_to_klv_key(klv_ctx)) >= 0) {
+    uint8_t *packet_start = klv_ctx->buf_ptr - 16;
+    uint8_t *checksum_end = NULL;
+    struct list_head *last_item = klv_ctx->klv_items.list.prev; /* packet items are appended after this */
 
-  /* print header */
-  printf("{");
+    /* packet length follows 16-byte uid */
+    klv_ctx->payload_len = klv_get_ber_length(klv_ctx);
+    uint8_t *payload_end = klv_ctx->buf_end;
+    if (klv_ctx->payload_len < (uint64_t)(klv_ctx->buf_end - klv_ctx->buf_ptr))
+      payload_end = klv_ctx->buf_ptr + klv_ctx->payload_len;
+
+    /* other standards, and ST0601 when overridden, go whole to their registered decoder */
+    if (standard != LIBKLV_ST0601 || klv_ctx->decoders[LIBKLV_ST0601] != NULL) {
+      if (klv_ctx->decoders[standard] != NULL) {
+        if (klv_ctx->decoders[standard](klv_ctx->decoder_user[standard], klv_ctx, klv_ctx->buf_ptr, (size_t)(payload_end - klv_ctx->buf_ptr)) < 0)
+          return -1;
+      } else if (klv_ctx->report != NULL) {
+        klv_ctx->report(klv_ctx->report_user, LIBKLV_REPORT_PACKET_NOT_HANDLED, (uint8_t)standard);
+      }
+      klv_ctx->buf_ptr = payload_end;
+      continue;
+    }
 
-  /* iterate through the payload and decode the fields */
-  while (klv_ctx->buf_ptr < klv_ctx->buf_end) {
-    p_tmp_item = (klv_item_t *)malloc(sizeof(klv_item_t));
-    memset(p_tmp_item, 0, sizeof(klv_item_t));
+    if (klv_ctx->filter != NULL && !libklv_filter_match(klv_ctx->filter, klv_ctx->buf_ptr, (size_t)(payload_end - klv_ctx->buf_ptr))) {
+      klv_ctx->buf_ptr = payload_end;
+      continue;
+    }
+    if (klv_ctx->dedup != NULL && libklv_dedup_seen(klv_ctx->dedup, klv_ctx->buf_ptr, (size_t)(payload_end - klv_ctx->buf_ptr))) {
+      klv_ctx->buf_ptr = payload_end;
+      continue;
+    }
+    if (klv_ctx->decimate != NULL && !libklv_decimate_keep(klv_ctx->decimate, klv_ctx->buf_ptr, (size_t)(payload_end - klv_ctx->buf_ptr))) {
+      klv_ctx->buf_ptr = payload_end;
+      continue;
+    }
 
-    p_tmp_item->id = *klv_ctx->buf_ptr++;
-    p_tmp_item->len = (uint8_t)klv_get_ber_length(klv_ctx);
+    /* iterate through the payload and decode the fields */
+    while (klv_ctx->buf_ptr + 2 <= payload_end) {
+      uint8_t id = *klv_ctx->buf_ptr++;
+      uint64_t len = klv_get_ber_length(klv_ctx);
+      uint8_t *value_start = klv_ctx->buf_ptr;
+
+      if (len > (uint64_t)(payload_end - value_start)) {
+        klv_ctx->buf_ptr = payload_end; /* truncated item */
+        break;
+      }
+
+      const klv_tag_desc_t *desc = &klv_ctx->tags[id];
+      if (desc->type == KLV_TYPE_LATER) {
+        /* the stream's version cannot mean it, so no item is listed */
+        if (klv_ctx->report != NULL)
+          klv_ctx->report(klv_ctx->report_user, LIBKLV_REPORT_KEY_NOT_HANDLED, id);
+        klv_ctx->buf_ptr = value_start + len;
+        continue;
+      }
+      if (len < desc->len) {
+        klv_ctx->buf_ptr = value_start + len; /* too short for the decoder's fixed-width read */
+        continue;
+      }
+
+      p_tmp_item = libklv_new_item(klv_ctx);
+      if (p_tmp_item == NULL)
+        return -1;
+
+      p_tmp_item->id = id;
+      p_tmp_item->len = (uint8_t)len;
+      p_tmp_item->raw = value_start;
+      p_tmp_item->raw_len = (size_t)len;
+
+      bytes_read += decode_klv_values(p_tmp_item, desc, klv_ctx);
+
+      /* stay in step with the BER length whatever width the decoder assumed */
+      klv_ctx->buf_ptr = value_start + len;
+
+      list_add_tail(&p_tmp_item->list, &klv_ctx->klv_items.list);
+
+      if (id == 0x01)
+        checksum_end = klv_ctx->buf_ptr;
+    }
 
-    bytes_read += decode_klv_values(p_tmp_item, klv_ctx, &current_klv_start);
+    /* calculate checksum. According to ST0601.1, packet should be discarded if calculated checksum doesn't match embedded value */
+    if (checksum_end != NULL && klv_ctx->report != NULL) {
+      if (has_valid_checksum(klv_ctx, (uint64_t)(packet_start - klv_ctx->buffer), (uint64_t)(checksum_end - packet_start)) == false) {
+        klv_ctx->report(klv_ctx->report_user, LIBKLV_REPORT_CHECKSUM_INVALID, 0x01);
+      } else {
+        klv_ctx->report(klv_ctx->report_user, LIBKLV_REPORT_CHECKSUM_VALID, 0x01);
+      }
+    }
 
-    list_add_tail(&p_tmp_item->list, &klv_ctx->klv_items.list);
+    if (last_item->next != &klv_ctx->klv_items.list)
+      libklv_write_packet(&klv_ctx->writer, last_item->next, &klv_ctx->klv_items.list);
   }
 
-  /* calculate checksum. According to ST0601.1, packet should be discarded if calculated checksum doesn't match embedded value */
-
   return bytes_read;
 }
@@ -7,15 +7,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "libklv_output.h"
 #include "list.h"
 
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
-#define ISO_STRING_LEN 24
 #define strdup _strdup
-#else
-static const uint8_t ISO_STRING_LEN = 24;
 #endif
 
+/* largest packet libklv_frame_packet accepts; longer BER lengths are treated as a false key match */
+#define LIBKLV_MAX_PACKET_SIZE (1 << 20)
+
 static const uint8_t klv_key[] = {0x06, 0x0e, 0x2b, 0x34};
 static const uint8_t klv_universal_key[] = {0x06, 0x0e, 0x2b, 0x34, 0x02, 0x0b, 0x01, 0x01, 0x0e, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00};
 
@@ -31,26 +32,88 @@ typedef struct klv_item_s {
 
   void *data; /* used for variable length values. almost exclusively strings */
 
+  const uint8_t *raw; /* encoded value inside the parsed buffer; valid until the buffer changes */
+  size_t raw_len;     /* full BER length of the value (len is truncated to 8 bits) */
+
+  void *storage;       /* backing allocation for data, kept when the item is recycled */
+  size_t storage_size; /* size of storage in bytes */
+
   struct list_head list;
 } klv_item_t;
 
+/* MISB local sets with a universal key libklv recognizes, see libklv_key_standard */
+typedef enum klv_standard_e {
+  LIBKLV_ST0601 = 0, /* UAS Datalink, decoded into klv_items */
+  LIBKLV_ST0102,     /* Security Metadata, standalone */
+  LIBKLV_ST0903,     /* Video Moving Target Indicator */
+  LIBKLV_ST1206,     /* SAR Motion Imagery */
+  LIBKLV_STANDARD_COUNT,
+} klv_standard_t;
+
+/* events a context reports while parsing, see libklv_set_report */
+typedef enum klv_report_e {
+  LIBKLV_REPORT_CHECKSUM_VALID = 0, /* the packet checksum matches */
+  LIBKLV_REPORT_CHECKSUM_INVALID,   /* the packet checksum does not match */
+  LIBKLV_REPORT_KEY_NOT_HANDLED,    /* a tag the decoder does not know was skipped */
+  LIBKLV_REPORT_PACKET_NOT_HANDLED, /* a packet of a standard without decoder was skipped; id is its klv_standard_t */
+  LIBKLV_REPORT_COUNT,
+} klv_report_t;
+
+typedef void (*klv_report_fn)(void *user, klv_report_t report, uint8_t id);
+
+struct klv_ctx_s;
+
+/* decoder for the local set payload of one packet, see libklv_set_decoder; negative on failure */
+typedef int (*klv_decode_fn)(void *user, struct klv_ctx_s *ctx, const uint8_t *payload, size_t len);
+
 typedef struct klv_ctx_s {
-  uint8_t *buffer;      /* start of the buffer */
-  uint16_t buffer_size; /* maximum buffer size */
-  uint8_t *buf_ptr;     /* current position in the buffer */
-  uint8_t *buf_end;     /* end of the data */
+  uint8_t *buffer;        /* start of the buffer */
+  size_t buffer_size;     /* number of bytes of data in the buffer */
+  uint8_t *owned;         /* the context's own allocation, kept while a buffer is borrowed */
+  size_t buffer_capacity; /* allocated size of owned */
+  bool owns_buffer;       /* false when the buffer is borrowed from the caller */
+  uint8_t *buf_ptr;       /* current position in the buffer */
+  uint8_t *buf_end;       /* end of the data */
 
-  klv_item_t klv_items; /* list of klv items parsed from a packet */
+  klv_item_t klv_items;  /* list of klv items parsed from a packet */
+  klv_item_t free_items; /* recycled items, reused before allocating new ones */
 
   uint64_t payload_len; /* length of payload according to BER value in packet */
   uint16_t checksum;    /* store checksum retrieved from packet (not calculated) */
+
+  klv_writer_t writer; /* output format and destination for decoded packets */
+
+  const struct klv_filter_s *filter; /* when set, packets it rejects are skipped undecoded */
+  struct klv_dedup_s *dedup;         /* when set, packets it has seen recently are skipped undecoded */
+  struct klv_decimate_s *decimate;   /* when set, packets it thins out are skipped undecoded */
+
+  const struct klv_tag_desc_s *tags; /* ST0601 tags as the stream's version defines them, see libklv_set_version */
+  bool version_seen;                 /* tags was chosen, from the first version tag (0x41) or by the caller */
+
+  klv_report_fn report; /* receives parse events, NULL to ignore them */
+  void *report_user;    /* passed back to report */
+
+  klv_decode_fn decoders[LIBKLV_STANDARD_COUNT]; /* per standard, NULL for the built-in ST0601 decoder or to skip */
+  void *decoder_user[LIBKLV_STANDARD_COUNT];     /* passed back to decoders */
 } klv_ctx_t;
 
 /*
  * Global prototypes
  */
 klv_ctx_t *libklv_init(void);
+void libklv_reset(klv_ctx_t *ctx);
+void libklv_set_output(klv_ctx_t *ctx, FILE *out, klv_output_format_t format);
+void libklv_set_report(klv_ctx_t *ctx, klv_report_fn report, void *user);
+void libklv_report_to_stream(void *user, klv_report_t report, uint8_t id);
+void libklv_set_decoder(klv_ctx_t *ctx, klv_standard_t standard, klv_decode_fn decode, void *user);
+void libklv_set_version(klv_ctx_t *ctx, int version);
+int libklv_key_standard(const uint8_t *key);
+int libklv_update_ctx_buffer(klv_ctx_t *ctx, void *src, size_t len);
+int libklv_borrow_ctx_buffer(klv_ctx_t *ctx, void *src, size_t len);
 int libklv_parse_data(klv_ctx_t *klv_ctx);
+klv_item_t *libklv_add_item(klv_ctx_t *ctx, uint8_t id, const uint8_t *value, size_t len);
+int libklv_frame_packet(const uint8_t *data, size_t size, size_t *start, size_t *len);
+uint16_t libklv_checksum(const uint8_t *packet, size_t len);
 void libklv_cleanup(klv_ctx_t *ctx);
 
 #endif // LIBKLV_H_INCLUDED
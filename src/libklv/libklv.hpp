@@ -0,0 +1,227 @@
+#ifndef LIBKLV_HPP_INCLUDED
+#define LIBKLV_HPP_INCLUDED
+
+/*
+ * Header-only C++20 view of libklv. Packets and items are non-owning views:
+ * byte and string accessors point straight into the caller's input buffer,
+ * so nothing is copied or allocated per packet once the context is warm.
+ * Views stay valid until the next parse on the same context and as long as
+ * the input buffer is kept alive and unchanged.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+extern "C" {
+#include "libklv.h"
+#include "libklv_tags.h"
+}
+
+namespace klv {
+
+/* a packet libklv could not decode, e.g. one a registered decoder rejected */
+class error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/* one decoded local set item */
+class item {
+public:
+  explicit item(const klv_item_t *item) noexcept : item_(item) {}
+
+  uint8_t id() const noexcept { return item_->id; }
+
+  /* encoded value bytes inside the input buffer */
+  std::span<const std::byte> raw() const noexcept {
+    return {reinterpret_cast<const std::byte *>(item_->raw), item_->raw_len};
+  }
+
+  uint64_t value() const noexcept { return item_->value; }
+  int64_t signed_value() const noexcept { return item_->signed_val; }
+  double mapped_value() const noexcept { return item_->mapped_val; }
+
+  /*
+   * Character data of string tags, viewed in place in the input buffer. Tags
+   * whose text libklv derives from a code (e.g. operational mode) return the
+   * copy kept with the item, which, like the item, is only valid until the
+   * next parse on the context. Empty for everything else.
+   */
+  std::string_view text() const noexcept {
+    const klv_tag_desc_t *d = libklv_tag_desc(item_->id);
+    if (d != nullptr && d->type == KLV_TYPE_STRING)
+      return {reinterpret_cast<const char *>(item_->raw), item_->raw_len};
+    if (d != nullptr && d->type == KLV_TYPE_UINT && item_->data != nullptr)
+      return static_cast<const char *>(item_->data);
+    return {};
+  }
+
+  /* tag description, nullptr for tags libklv does not describe */
+  const klv_tag_desc_t *desc() const noexcept { return libklv_tag_desc(item_->id); }
+
+  /* snake_case tag name, e.g. "sensor_latitude"; empty if not described */
+  std::string_view name() const noexcept {
+    const klv_tag_desc_t *d = desc();
+    return (d != nullptr && d->name != nullptr) ? std::string_view(d->name) : std::string_view();
+  }
+
+  const klv_item_t *get() const noexcept { return item_; }
+
+private:
+  const klv_item_t *item_;
+};
+
+/* forward iterator over the items of one packet */
+class item_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = item;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = item;
+
+  item_iterator() noexcept = default;
+  explicit item_iterator(const struct list_head *pos) noexcept : pos_(pos) {}
+
+  item operator*() const noexcept { return item(list_entry(pos_, klv_item_t, list)); }
+  item_iterator &operator++() noexcept {
+    pos_ = pos_->next;
+    return *this;
+  }
+  item_iterator operator++(int) noexcept {
+    item_iterator tmp = *this;
+    pos_ = pos_->next;
+    return tmp;
+  }
+  bool operator==(const item_iterator &other) const noexcept { return pos_ == other.pos_; }
+
+private:
+  const struct list_head *pos_ = nullptr;
+};
+
+/* one framed packet and the items decoded from it */
+class packet {
+public:
+  packet() noexcept = default;
+  packet(std::span<const std::byte> bytes, const struct list_head *items) noexcept
+      : bytes_(bytes), items_(items) {}
+
+  /* the whole packet, universal key through checksum, inside the input buffer */
+  std::span<const std::byte> bytes() const noexcept { return bytes_; }
+
+  item_iterator begin() const noexcept { return item_iterator(items_ != nullptr ? items_->next : nullptr); }
+  item_iterator end() const noexcept { return item_iterator(items_); }
+  bool empty() const noexcept { return items_ == nullptr || list_empty(items_); }
+
+  /* first item with the given tag, if any */
+  const klv_item_t *find(uint8_t id) const noexcept {
+    for (item i : *this) {
+      if (i.id() == id)
+        return i.get();
+    }
+    return nullptr;
+  }
+
+  /* true when the packet carries a checksum (tag 0x01) that matches its contents */
+  bool checksum_valid() const noexcept {
+    const klv_item_t *sum = find(0x01);
+    if (sum == nullptr)
+      return false;
+    const uint8_t *start = reinterpret_cast<const uint8_t *>(bytes_.data());
+    size_t covered = static_cast<size_t>(sum->raw + sum->raw_len - start) - 2;
+    return libklv_checksum(start, covered) == static_cast<uint16_t>(sum->value);
+  }
+
+private:
+  std::span<const std::byte> bytes_;
+  const struct list_head *items_ = nullptr;
+};
+
+/* move-only owner of a klv_ctx_t, set up to decode without writing any output */
+class context {
+public:
+  context() : ctx_(libklv_init()) {
+    if (ctx_ == nullptr)
+      throw std::bad_alloc();
+    libklv_set_output(ctx_, nullptr, LIBKLV_OUTPUT_NONE);
+    libklv_set_report(ctx_, nullptr, nullptr); /* packet::checksum_valid() answers instead */
+  }
+  ~context() { libklv_cleanup(ctx_); }
+
+  context(const context &) = delete;
+  context &operator=(const context &) = delete;
+  context(context &&other) noexcept : ctx_(std::exchange(other.ctx_, nullptr)) {}
+  context &operator=(context &&other) noexcept {
+    if (this != &other) {
+      libklv_cleanup(ctx_);
+      ctx_ = std::exchange(other.ctx_, nullptr);
+    }
+    return *this;
+  }
+
+  /* receive checksum and unhandled key events, see libklv_set_report */
+  void set_report(klv_report_fn report, void *user) { libklv_set_report(ctx_, report, user); }
+
+  /*
+   * Decode the single packet in bytes, e.g. one framed by next_packet().
+   * The buffer is borrowed, not copied. Throws klv::error when libklv fails
+   * to decode it.
+   */
+  packet parse(std::span<const std::byte> bytes) {
+    void *data = const_cast<std::byte *>(bytes.data()); /* libklv only reads a borrowed buffer */
+    libklv_borrow_ctx_buffer(ctx_, data, bytes.size());
+    if (libklv_parse_data(ctx_) < 0)
+      throw error("libklv_parse_data failed");
+    return packet(bytes, &ctx_->klv_items.list);
+  }
+
+  /*
+   * Call fn(packet) for every complete ST0601 packet in input, in order;
+   * packets of other standards are skipped. Returns the number of leading
+   * bytes consumed; anything after that is an incomplete packet to present
+   * again once more data has arrived.
+   */
+  template <typename Fn>
+  size_t for_each_packet(std::span<const std::byte> input, Fn &&fn) {
+    size_t offset = 0;
+    std::span<const std::byte> bytes;
+    while (next_packet(input, offset, bytes)) {
+      if (libklv_key_standard(reinterpret_cast<const uint8_t *>(bytes.data())) == LIBKLV_ST0601)
+        fn(parse(bytes));
+    }
+    return offset;
+  }
+
+  /*
+   * Frame the next complete packet at or after offset without decoding it.
+   * On success bytes is set to the packet and offset moves past it; otherwise
+   * offset moves past the bytes that can be discarded.
+   */
+  static bool next_packet(std::span<const std::byte> input, size_t &offset, std::span<const std::byte> &bytes) noexcept {
+    size_t start = 0;
+    size_t len = 0;
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(input.data()) + offset;
+    if (!libklv_frame_packet(data, input.size() - offset, &start, &len)) {
+      offset += start;
+      return false;
+    }
+    bytes = input.subspan(offset + start, len);
+    offset += start + len;
+    return true;
+  }
+
+  klv_ctx_t *get() const noexcept { return ctx_; }
+
+private:
+  klv_ctx_t *ctx_;
+};
+
+} // namespace klv
+
+#endif // LIBKLV_HPP_INCLUDED
@@ -0,0 +1,206 @@
+#include "libklv_aggregate.h"
+#include "libklv.h"
+#include "libklv_tags.h"
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+
+#define FULL_TURN 360.0
+#define RADIANS_PER_DEGREE 0.017453292519943295
+
+/*****************************************************************************
+ * item_number
+ *
+ * Numeric value of an item as the output formats see it. Returns false for
+ * out-of-range values.
+ *****************************************************************************/
+static bool item_number(const klv_item_t *item, const klv_tag_desc_t *desc, double *value) {
+  if (desc->min < desc->max) {
+    if (item->mapped_val == DBL_MIN) /* DBL_MIN flags an out-of-range value */
+      return false;
+    *value = item->mapped_val;
+  } else if (desc->type == KLV_TYPE_INT) {
+    *value = (double)item->signed_val;
+  } else {
+    *value = (double)item->value;
+  }
+  return true;
+}
+
+/*****************************************************************************
+ * is_circular
+ *
+ * Whether a tag is an angle or longitude mapped onto a full turn, so that its
+ * values wrap around. Other tags with the same range, e.g. vertical speed,
+ * do not.
+ *****************************************************************************/
+static bool is_circular(uint8_t id) {
+  switch (id) {
+  case 0x05: /* platform heading angle */
+  case 0x0E: /* sensor longitude */
+  case 0x12: /* sensor relative azimuth angle */
+  case 0x13: /* sensor relative elevation angle */
+  case 0x14: /* sensor relative roll angle */
+  case 0x18: /* frame center longitude */
+  case 0x23: /* wind direction */
+  case 0x29: /* target location longitude */
+  case 0x40: /* platform magnetic heading */
+  case 0x44: /* alternate platform longitude */
+  case 0x47: /* alternate platform heading */
+  case 0x53: /* corner longitude point 1 */
+  case 0x55: /* corner longitude point 2 */
+  case 0x57: /* corner longitude point 3 */
+  case 0x59: /* corner longitude point 4 */
+    return true;
+  default:
+    return false;
+  }
+}
+
+/*****************************************************************************
+ * reset_window
+ *****************************************************************************/
+static void reset_window(klv_aggregate_t *aggregate) {
+  aggregate->open = false;
+  aggregate->packets = 0;
+  for (int i = 0; i < aggregate->num_fields; i++) {
+    klv_field_stats_t *field = &aggregate->fields[i];
+    field->count = 0;
+    field->first_time = field->last_time = 0;
+  }
+}
+
+/*****************************************************************************
+ * libklv_aggregate_init
+ *
+ * Start an aggregation with no fields over windows of window microseconds.
+ *****************************************************************************/
+void libklv_aggregate_init(klv_aggregate_t *aggregate, uint64_t window) {
+  memset(aggregate, 0, sizeof(*aggregate));
+  aggregate->window = (window > 0) ? window : 1;
+}
+
+/*****************************************************************************
+ * libklv_aggregate_add_field
+ *
+ * Aggregate a numeric tag. Returns -1 for tags that are not numeric or when
+ * LIBKLV_AGGREGATE_MAX_FIELDS are already aggregated.
+ *****************************************************************************/
+int libklv_aggregate_add_field(klv_aggregate_t *aggregate, uint8_t id) {
+  const klv_tag_desc_t *desc = libklv_tag_desc(id);
+
+  if (desc == NULL || (desc->type != KLV_TYPE_UINT && desc->type != KLV_TYPE_INT))
+    return -1;
+  if (aggregate->slot[id] != 0)
+    return 0;
+  if (aggregate->num_fields == LIBKLV_AGGREGATE_MAX_FIELDS)
+    return -1;
+
+  klv_field_stats_t *field = &aggregate->fields[aggregate->num_fields++];
+  memset(field, 0, sizeof(*field));
+  field->id = id;
+  field->circular = is_circular(id);
+  aggregate->slot[id] = aggregate->num_fields;
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_aggregate_packet
+ *
+ * Add the items [first, end) of one decoded packet, writing out the current
+ * window first if the packet's time stamp lies outside it.
+ *****************************************************************************/
+int libklv_aggregate_packet(klv_aggregate_t *aggregate, FILE *out, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    if (item->id == 0x02 && item->raw != NULL) {
+      aggregate->time = item->value;
+      break;
+    }
+  }
+
+  uint64_t start = aggregate->time - aggregate->time % aggregate->window;
+  if (aggregate->open && start != aggregate->window_start) {
+    if (libklv_aggregate_flush(aggregate, out) < 0)
+      return -1;
+  }
+  if (!aggregate->open) {
+    aggregate->open = true;
+    aggregate->window_start = start;
+  }
+  aggregate->packets++;
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    double value;
+
+    if (aggregate->slot[item->id] == 0 || !item_number(item, libklv_tag_desc(item->id), &value))
+      continue;
+
+    klv_field_stats_t *field = &aggregate->fields[aggregate->slot[item->id] - 1];
+    if (field->count == 0) {
+      field->min = field->max = field->sum = value;
+      field->first = value;
+      field->first_time = aggregate->time;
+      field->sin_sum = field->cos_sum = field->turned = 0.0;
+    } else {
+      if (value < field->min)
+        field->min = value;
+      if (value > field->max)
+        field->max = value;
+      field->sum += value;
+      if (field->circular)
+        field->turned += remainder(value - field->last, FULL_TURN); /* within +/-180 */
+    }
+    if (field->circular) {
+      field->sin_sum += sin(value * RADIANS_PER_DEGREE);
+      field->cos_sum += cos(value * RADIANS_PER_DEGREE);
+    }
+    field->last = value;
+    field->last_time = aggregate->time;
+    field->count++;
+  }
+
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_aggregate_flush
+ *
+ * Write out the current window, if it has packets, and start a new one.
+ *****************************************************************************/
+int libklv_aggregate_flush(klv_aggregate_t *aggregate, FILE *out) {
+  if (!aggregate->open)
+    return 0;
+
+  fprintf(out, "{\"window start\": %" PRIu64 ", \"window end\": %" PRIu64 ", \"packets\": %" PRIu64, aggregate->window_start,
+          aggregate->window_start + aggregate->window, aggregate->packets);
+
+  for (int i = 0; i < aggregate->num_fields; i++) {
+    const klv_field_stats_t *field = &aggregate->fields[i];
+    if (field->count == 0)
+      continue;
+
+    const klv_tag_desc_t *desc = libklv_tag_desc(field->id);
+    double mean = field->sum / (double)field->count;
+    double change = field->last - field->first;
+    if (field->circular) {
+      mean = atan2(field->sin_sum, field->cos_sum) / RADIANS_PER_DEGREE;
+      if (mean < desc->min)
+        mean += FULL_TURN; /* back into the tag's range */
+      change = field->turned;
+    }
+    fprintf(out, ", \"%s\": {\"count\": %" PRIu64 ", \"min\": %.15g, \"max\": %.15g, \"mean\": %.15g, \"rate\": ",
+            desc->name, field->count, field->min, field->max, mean);
+    if (field->last_time > field->first_time)
+      fprintf(out, "%.15g}", change * 1e6 / (double)(field->last_time - field->first_time));
+    else
+      fputs("null}", out);
+  }
+  fputs("}\n", out);
+
+  reset_window(aggregate);
+  return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,67 @@
+#ifndef LIBKLV_AGGREGATE_H_INCLUDED
+#define LIBKLV_AGGREGATE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "list.h"
+
+#define LIBKLV_AGGREGATE_MAX_FIELDS 32
+
+/* running statistics of one tag within the current window */
+typedef struct klv_field_stats_s {
+  uint8_t id;          /* ST0601 tag */
+  bool circular;       /* mapped onto a full turn of degrees, e.g. a heading */
+  uint64_t count;      /* samples in the window */
+  double min;
+  double max;
+  double sum;
+  double sin_sum;      /* sums of the unit vectors of circular samples, for the mean */
+  double cos_sum;
+  double turned;       /* change of circular samples, each step taken the shorter way round */
+  double first;        /* earliest timed sample, for the rate */
+  double last;         /* latest timed sample */
+  uint64_t first_time; /* precision time stamps of first and last */
+  uint64_t last_time;
+} klv_field_stats_t;
+
+/*
+ * Summarizes the numeric fields of a stream of packets over fixed windows of
+ * precision time stamp (0x02), writing one JSON object per window instead of
+ * one per packet:
+ *
+ *   {"window start": t, "window end": t, "packets": n,
+ *    "<tag name>": {"count": n, "min": x, "max": x, "mean": x, "rate": x|null}, ...}
+ *
+ * Values are the mapped values of mapped tags and the integers of the others;
+ * out-of-range values are not counted. rate is the change per second between
+ * the first and last sample of the window. Headings, relative sensor angles,
+ * wind direction and longitudes are circular: their mean is the direction of
+ * the mean unit vector, and their change sums the steps between samples
+ * taken the shorter way round, so neither jumps across north or the
+ * antimeridian. min and max remain the plain extremes. Packets without a time stamp fall
+ * in the current window. A time stamp outside the current window closes it.
+ * All state is fixed size, so aggregating never allocates.
+ */
+typedef struct klv_aggregate_s {
+  uint64_t window;       /* window length in microseconds */
+  uint64_t window_start; /* start of the current window */
+  uint64_t time;         /* latest precision time stamp seen */
+  bool open;             /* the current window has packets */
+  uint64_t packets;      /* packets in the current window */
+
+  uint8_t num_fields;
+  klv_field_stats_t fields[LIBKLV_AGGREGATE_MAX_FIELDS];
+  uint8_t slot[256]; /* index into fields + 1 of each tag, 0 when not aggregated */
+} klv_aggregate_t;
+
+/*
+ * Global prototypes
+ */
+void libklv_aggregate_init(klv_aggregate_t *aggregate, uint64_t window);
+int libklv_aggregate_add_field(klv_aggregate_t *aggregate, uint8_t id);
+int libklv_aggregate_packet(klv_aggregate_t *aggregate, FILE *out, const struct list_head *first, const struct list_head *end);
+int libklv_aggregate_flush(klv_aggregate_t *aggregate, FILE *out);
+
+#endif // LIBKLV_AGGREGATE_H_INCLUDED
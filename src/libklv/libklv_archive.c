@@ -0,0 +1,746 @@
+#include "libklv_archive.h"
+#include "libklv_decimate.h"
+#include "libklv_dedup.h"
+#include "libklv_filter.h"
+#include "libklv_tags.h"
+
+#define ARCHIVE_MAX_SHAPES 256
+#define ARCHIVE_MAX_STRINGS 65536
+#define ARCHIVE_MAX_STRING_BYTES (16 << 20)
+#define ARCHIVE_DICT_SLOTS (2 * ARCHIVE_MAX_STRINGS) /* power of two, at most half full */
+
+typedef struct archive_buf_s {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+} archive_buf_t;
+
+typedef struct archive_string_s {
+  uint32_t offset; /* start of the bytes in string_data */
+  uint32_t len;
+  uint32_t hash;
+} archive_string_t;
+
+struct klv_archive_writer_s {
+  FILE *out;
+  int error;
+
+  uint32_t num_packets; /* packets in the block being built */
+  uint64_t first_time;
+  uint64_t last_time;
+  bool has_time;
+
+  archive_buf_t shape;  /* shape of the packet being written */
+  archive_buf_t shapes; /* shapes of the block, back to back */
+  uint32_t shape_offsets[ARCHIVE_MAX_SHAPES + 1];
+  uint32_t num_shapes;
+
+  archive_buf_t string_data;  /* dictionary entries, back to back */
+  archive_string_t *strings;  /* dictionary entries by index */
+  uint32_t num_strings;
+  uint32_t *slots;            /* hash of the dictionary: entry index + 1, 0 when free */
+
+  archive_buf_t packets;      /* shape index of each packet */
+  archive_buf_t columns[256]; /* value stream of each tag */
+  uint64_t prev[256];         /* last raw integer of each tag in the block */
+  archive_buf_t payload;      /* staging for the block being written out */
+};
+
+typedef struct archive_column_s {
+  const uint8_t *ptr;
+  const uint8_t *end;
+  uint64_t prev;
+} archive_column_t;
+
+typedef struct archive_block_s {
+  size_t offset;
+  uint64_t first_time;
+  uint64_t last_time;
+} archive_block_t;
+
+struct klv_archive_reader_s {
+  const uint8_t *data;
+  size_t size;
+  size_t next_block; /* offset of the block after the current one */
+
+  uint32_t num_packets; /* packets in the current block */
+  uint32_t packet;      /* next packet to read from it */
+
+  const uint8_t *shape_ptr[ARCHIVE_MAX_SHAPES];
+  size_t shape_len[ARCHIVE_MAX_SHAPES];
+  uint32_t num_shapes;
+
+  const uint8_t **string_ptr;
+  size_t *string_len;
+  uint32_t num_strings;
+  uint32_t strings_capacity;
+
+  const uint8_t *packets;
+  const uint8_t *packets_end;
+  archive_column_t columns[256];
+
+  uint8_t *values; /* big-endian integers of the current packet, the items' raw bytes */
+  size_t values_capacity;
+
+  uint8_t *local_set; /* the current packet as local set bytes, for dedup and decimate */
+  size_t local_set_capacity;
+  size_t local_set_len;
+
+  archive_block_t *blocks; /* every block of the archive, built by the first seek */
+  size_t num_blocks;
+};
+
+/*****************************************************************************
+ * buf_reserve
+ *****************************************************************************/
+static int buf_reserve(archive_buf_t *b, size_t extra) {
+  if (b->size + extra <= b->capacity)
+    return 0;
+
+  size_t capacity = (b->capacity > 0) ? b->capacity : 256;
+  while (capacity < b->size + extra)
+    capacity *= 2;
+  uint8_t *tmp = (uint8_t *)realloc(b->data, capacity);
+  if (tmp == NULL)
+    return -1;
+  b->data = tmp;
+  b->capacity = capacity;
+  return 0;
+}
+
+/*****************************************************************************
+ * buf_put
+ *****************************************************************************/
+static int buf_put(archive_buf_t *b, const void *src, size_t len) {
+  if (buf_reserve(b, len) < 0)
+    return -1;
+  memcpy(b->data + b->size, src, len);
+  b->size += len;
+  return 0;
+}
+
+/*****************************************************************************
+ * buf_varint
+ *
+ * Unsigned LEB128: seven bits per byte, low bits first, high bit set on every
+ * byte but the last.
+ *****************************************************************************/
+static int buf_varint(archive_buf_t *b, uint64_t v) {
+  if (buf_reserve(b, 10) < 0)
+    return -1;
+  while (v >= 0x80) {
+    b->data[b->size++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  b->data[b->size++] = (uint8_t)v;
+  return 0;
+}
+
+/*****************************************************************************
+ * get_varint
+ *****************************************************************************/
+static int get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v) {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (*p >= end)
+      return -1;
+    uint8_t byte = *(*p)++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *v = value;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* zig-zag: small negative and positive deltas both become small unsigned numbers */
+static inline uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void put_le(uint8_t *p, uint64_t v, int len) {
+  for (int i = 0; i < len; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t *p, int len) {
+  uint64_t v = 0;
+  for (int i = len - 1; i >= 0; i--)
+    v = v << 8 | p[i];
+  return v;
+}
+
+/*****************************************************************************
+ * int_desc
+ *
+ * The descriptor of an item stored as an integer column, NULL for items
+ * stored in the dictionary. Decided from the tag and length alone, so the
+ * reader reaches the same answer from the shape.
+ *****************************************************************************/
+static const klv_tag_desc_t *int_desc(uint8_t id, size_t len) {
+  const klv_tag_desc_t *desc = libklv_tag_desc(id);
+  if (desc != NULL && (desc->type == KLV_TYPE_UINT || desc->type == KLV_TYPE_INT) && desc->len > 0 && len >= desc->len)
+    return desc;
+  return NULL;
+}
+
+/*****************************************************************************
+ * read_raw
+ *
+ * Big-endian raw integer, sign-extended for signed tags so that deltas across
+ * zero stay small.
+ *****************************************************************************/
+static uint64_t read_raw(const uint8_t *p, const klv_tag_desc_t *desc) {
+  uint64_t v = 0;
+  for (int i = 0; i < desc->len; i++)
+    v = v << 8 | p[i];
+  if (desc->type == KLV_TYPE_INT && desc->len < 8) {
+    uint64_t sign = UINT64_C(1) << (8 * desc->len - 1);
+    v = (v ^ sign) - sign;
+  }
+  return v;
+}
+
+/*****************************************************************************
+ * fnv1a
+ *****************************************************************************/
+static uint32_t fnv1a(const uint8_t *data, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+    hash = (hash ^ data[i]) * 16777619u;
+  return hash;
+}
+
+/*****************************************************************************
+ * dict_add
+ *
+ * Index of data in the block's dictionary, adding it if it is new.
+ *****************************************************************************/
+static uint32_t dict_add(klv_archive_writer_t *writer, const uint8_t *data, size_t len) {
+  uint32_t hash = fnv1a(data, len);
+  uint32_t mask = ARCHIVE_DICT_SLOTS - 1;
+
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    uint32_t slot = writer->slots[i];
+    if (slot == 0) {
+      archive_string_t *entry = &writer->strings[writer->num_strings];
+      entry->offset = (uint32_t)writer->string_data.size;
+      entry->len = (uint32_t)len;
+      entry->hash = hash;
+      writer->error |= buf_put(&writer->string_data, data, len);
+      writer->slots[i] = ++writer->num_strings;
+      return writer->num_strings - 1;
+    }
+    const archive_string_t *entry = &writer->strings[slot - 1];
+    if (entry->hash == hash && entry->len == len && memcmp(writer->string_data.data + entry->offset, data, len) == 0)
+      return slot - 1;
+  }
+}
+
+/*****************************************************************************
+ * shape_index
+ *
+ * Index of the current packet's shape in the block, adding it if it is new.
+ *****************************************************************************/
+static uint32_t shape_index(klv_archive_writer_t *writer) {
+  for (uint32_t i = 0; i < writer->num_shapes; i++) {
+    uint32_t len = writer->shape_offsets[i + 1] - writer->shape_offsets[i];
+    if (len == writer->shape.size && memcmp(writer->shapes.data + writer->shape_offsets[i], writer->shape.data, len) == 0)
+      return i;
+  }
+
+  writer->error |= buf_put(&writer->shapes, writer->shape.data, writer->shape.size);
+  writer->shape_offsets[++writer->num_shapes] = (uint32_t)writer->shapes.size;
+  return writer->num_shapes - 1;
+}
+
+/*****************************************************************************
+ * libklv_archive_writer_init
+ *****************************************************************************/
+klv_archive_writer_t *libklv_archive_writer_init(FILE *out) {
+  klv_archive_writer_t *writer = (klv_archive_writer_t *)calloc(1, sizeof(klv_archive_writer_t));
+  if (writer == NULL)
+    return NULL;
+
+  writer->out = out;
+  writer->strings = (archive_string_t *)malloc(ARCHIVE_MAX_STRINGS * sizeof(archive_string_t));
+  writer->slots = (uint32_t *)calloc(ARCHIVE_DICT_SLOTS, sizeof(uint32_t));
+  if (writer->strings == NULL || writer->slots == NULL) {
+    free(writer->strings);
+    free(writer->slots);
+    free(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+/*****************************************************************************
+ * libklv_archive_write_packet
+ *
+ * Add the items [first, end) of one decoded packet to the block being built,
+ * writing the block out once it is full.
+ *****************************************************************************/
+int libklv_archive_write_packet(klv_archive_writer_t *writer, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+  size_t num_items = 0;
+
+  writer->shape.size = 0;
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    if (item->raw == NULL)
+      continue;
+    writer->error |= buf_put(&writer->shape, &item->id, 1);
+    writer->error |= buf_varint(&writer->shape, item->raw_len);
+    num_items++;
+  }
+
+  if (writer->num_packets >= LIBKLV_ARCHIVE_BLOCK_PACKETS || writer->num_shapes == ARCHIVE_MAX_SHAPES ||
+      writer->num_strings + num_items > ARCHIVE_MAX_STRINGS || writer->string_data.size > ARCHIVE_MAX_STRING_BYTES) {
+    if (libklv_archive_flush(writer) < 0)
+      return -1;
+  }
+  if (num_items > ARCHIVE_MAX_STRINGS)
+    return -1;
+
+  writer->error |= buf_varint(&writer->packets, shape_index(writer));
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    if (item->raw == NULL)
+      continue;
+
+    archive_buf_t *column = &writer->columns[item->id];
+    const klv_tag_desc_t *desc = int_desc(item->id, item->raw_len);
+    if (desc != NULL) {
+      uint64_t v = read_raw(item->raw, desc);
+      writer->error |= buf_varint(column, zigzag((int64_t)(v - writer->prev[item->id])));
+      writer->prev[item->id] = v;
+
+      if (item->id == 0x02) { /* precision time stamp */
+        if (!writer->has_time)
+          writer->first_time = v;
+        writer->last_time = v;
+        writer->has_time = true;
+      }
+    } else {
+      writer->error |= buf_varint(column, dict_add(writer, item->raw, item->raw_len));
+    }
+  }
+
+  writer->num_packets++;
+  return writer->error ? -1 : 0;
+}
+
+/*****************************************************************************
+ * libklv_archive_flush
+ *
+ * Write out the block being built, if any, and start a new one.
+ *****************************************************************************/
+int libklv_archive_flush(klv_archive_writer_t *writer) {
+  archive_buf_t *payload = &writer->payload;
+  uint8_t header[LIBKLV_ARCHIVE_HEADER_SIZE];
+  uint32_t num_columns = 0;
+
+  if (writer->num_packets == 0)
+    return writer->error ? -1 : 0;
+
+  payload->size = 0;
+  writer->error |= buf_varint(payload, writer->num_shapes);
+  for (uint32_t i = 0; i < writer->num_shapes; i++) {
+    uint32_t len = writer->shape_offsets[i + 1] - writer->shape_offsets[i];
+    writer->error |= buf_varint(payload, len);
+    writer->error |= buf_put(payload, writer->shapes.data + writer->shape_offsets[i], len);
+  }
+  writer->error |= buf_varint(payload, writer->num_strings);
+  for (uint32_t i = 0; i < writer->num_strings; i++) {
+    writer->error |= buf_varint(payload, writer->strings[i].len);
+    writer->error |= buf_put(payload, writer->string_data.data + writer->strings[i].offset, writer->strings[i].len);
+  }
+  writer->error |= buf_varint(payload, writer->packets.size);
+  writer->error |= buf_put(payload, writer->packets.data, writer->packets.size);
+  for (int id = 0; id < 256; id++)
+    num_columns += (writer->columns[id].size > 0);
+  writer->error |= buf_varint(payload, num_columns);
+  for (int id = 0; id < 256; id++) {
+    archive_buf_t *column = &writer->columns[id];
+    if (column->size == 0)
+      continue;
+    uint8_t tag = (uint8_t)id;
+    writer->error |= buf_put(payload, &tag, 1);
+    writer->error |= buf_varint(payload, column->size);
+    writer->error |= buf_put(payload, column->data, column->size);
+  }
+
+  memcpy(header, LIBKLV_ARCHIVE_MAGIC, 4);
+  header[4] = LIBKLV_ARCHIVE_VERSION;
+  header[5] = header[6] = header[7] = 0;
+  put_le(header + 8, payload->size, 4);
+  put_le(header + 12, writer->num_packets, 4);
+  put_le(header + 16, writer->first_time, 8);
+  put_le(header + 24, writer->last_time, 8);
+
+  if (!writer->error && (fwrite(header, 1, sizeof(header), writer->out) != sizeof(header) ||
+                         fwrite(payload->data, 1, payload->size, writer->out) != payload->size))
+    writer->error = 1;
+
+  /* every block starts from scratch so it can be decoded on its own */
+  writer->num_packets = 0;
+  writer->first_time = writer->last_time = 0;
+  writer->has_time = false;
+  writer->shapes.size = 0;
+  writer->num_shapes = 0;
+  writer->string_data.size = 0;
+  writer->num_strings = 0;
+  memset(writer->slots, 0, ARCHIVE_DICT_SLOTS * sizeof(uint32_t));
+  writer->packets.size = 0;
+  for (int id = 0; id < 256; id++)
+    writer->columns[id].size = 0;
+  memset(writer->prev, 0, sizeof(writer->prev));
+
+  return writer->error ? -1 : 0;
+}
+
+/*****************************************************************************
+ * libklv_archive_writer_finish
+ *
+ * Write out the last block and free the writer.
+ *****************************************************************************/
+int libklv_archive_writer_finish(klv_archive_writer_t *writer) {
+  if (writer == NULL)
+    return 0;
+
+  int ret = libklv_archive_flush(writer);
+  free(writer->shape.data);
+  free(writer->shapes.data);
+  free(writer->string_data.data);
+  free(writer->strings);
+  free(writer->slots);
+  free(writer->packets.data);
+  for (int id = 0; id < 256; id++)
+    free(writer->columns[id].data);
+  free(writer->payload.data);
+  free(writer);
+  return ret;
+}
+
+/*****************************************************************************
+ * libklv_is_archive
+ *****************************************************************************/
+bool libklv_is_archive(const uint8_t *data, size_t size) {
+  return size >= LIBKLV_ARCHIVE_HEADER_SIZE && memcmp(data, LIBKLV_ARCHIVE_MAGIC, 4) == 0;
+}
+
+/*****************************************************************************
+ * libklv_archive_reader_init
+ *
+ * Read an archive straight out of a caller-owned buffer, e.g. a mapped file.
+ * The caller must keep data alive and unchanged while the reader and any
+ * items read from it are in use.
+ *****************************************************************************/
+klv_archive_reader_t *libklv_archive_reader_init(const uint8_t *data, size_t size) {
+  klv_archive_reader_t *reader = (klv_archive_reader_t *)calloc(1, sizeof(klv_archive_reader_t));
+  if (reader == NULL)
+    return NULL;
+
+  reader->data = data;
+  reader->size = size;
+  return reader;
+}
+
+/*****************************************************************************
+ * load_block
+ *
+ * Returns 1 when the next block is loaded, 0 at the end of the archive and
+ * -1 on malformed data or allocation failure.
+ *****************************************************************************/
+static int load_block(klv_archive_reader_t *reader) {
+  uint64_t n = 0;
+  uint64_t len = 0;
+
+  if (reader->next_block >= reader->size)
+    return 0;
+  if (reader->size - reader->next_block < LIBKLV_ARCHIVE_HEADER_SIZE)
+    return -1;
+
+  const uint8_t *header = reader->data + reader->next_block;
+  if (memcmp(header, LIBKLV_ARCHIVE_MAGIC, 4) != 0 || header[4] != LIBKLV_ARCHIVE_VERSION)
+    return -1;
+  uint64_t payload_size = get_le(header + 8, 4);
+  if (payload_size > reader->size - reader->next_block - LIBKLV_ARCHIVE_HEADER_SIZE)
+    return -1;
+
+  const uint8_t *p = header + LIBKLV_ARCHIVE_HEADER_SIZE;
+  const uint8_t *end = p + payload_size;
+
+  if (get_varint(&p, end, &n) < 0 || n > ARCHIVE_MAX_SHAPES)
+    return -1;
+  reader->num_shapes = (uint32_t)n;
+  for (uint32_t i = 0; i < reader->num_shapes; i++) {
+    if (get_varint(&p, end, &len) < 0 || len > (uint64_t)(end - p))
+      return -1;
+    reader->shape_ptr[i] = p;
+    reader->shape_len[i] = (size_t)len;
+    p += len;
+  }
+
+  if (get_varint(&p, end, &n) < 0 || n > ARCHIVE_MAX_STRINGS)
+    return -1;
+  if (n > reader->strings_capacity) {
+    const uint8_t **ptrs = (const uint8_t **)realloc(reader->string_ptr, n * sizeof(*ptrs));
+    if (ptrs != NULL)
+      reader->string_ptr = ptrs;
+    size_t *lens = (size_t *)realloc(reader->string_len, n * sizeof(*lens));
+    if (lens != NULL)
+      reader->string_len = lens;
+    if (ptrs == NULL || lens == NULL)
+      return -1;
+    reader->strings_capacity = (uint32_t)n;
+  }
+  reader->num_strings = (uint32_t)n;
+  for (uint32_t i = 0; i < reader->num_strings; i++) {
+    if (get_varint(&p, end, &len) < 0 || len > (uint64_t)(end - p))
+      return -1;
+    reader->string_ptr[i] = p;
+    reader->string_len[i] = (size_t)len;
+    p += len;
+  }
+
+  if (get_varint(&p, end, &len) < 0 || len > (uint64_t)(end - p))
+    return -1;
+  reader->packets = p;
+  reader->packets_end = p + len;
+  p += len;
+
+  memset(reader->columns, 0, sizeof(reader->columns));
+  if (get_varint(&p, end, &n) < 0 || n > 256)
+    return -1;
+  for (uint64_t i = 0; i < n; i++) {
+    if (p >= end)
+      return -1;
+    uint8_t id = *p++;
+    if (get_varint(&p, end, &len) < 0 || len > (uint64_t)(end - p))
+      return -1;
+    reader->columns[id].ptr = p;
+    reader->columns[id].end = p + len;
+    p += len;
+  }
+
+  reader->num_packets = (uint32_t)get_le(header + 12, 4);
+  reader->packet = 0;
+  reader->next_block = (size_t)(end - reader->data);
+  return 1;
+}
+
+/*****************************************************************************
+ * put_item
+ *
+ * Append one item to a local set as tag, BER length and value.
+ *****************************************************************************/
+static uint8_t *put_item(uint8_t *p, uint8_t id, const uint8_t *value, size_t len) {
+  *p++ = id;
+  if (len < 0x80) {
+    *p++ = (uint8_t)len;
+  } else {
+    int bytes_num = 0;
+    while (bytes_num < 8 && (len >> (8 * bytes_num)) != 0)
+      bytes_num++;
+    *p++ = (uint8_t)(0x80 | bytes_num);
+    while (bytes_num--)
+      *p++ = (uint8_t)(len >> (8 * bytes_num));
+  }
+  memcpy(p, value, len);
+  return p + len;
+}
+
+/*****************************************************************************
+ * read_packet
+ *
+ * Rebuild the next packet's items, and when ctx dedups or decimates also
+ * its local set bytes in reader->local_set.
+ *****************************************************************************/
+static int read_packet(klv_archive_reader_t *reader, klv_ctx_t *ctx) {
+  uint64_t index = 0;
+  bool rebuild_set = ctx->dedup != NULL || ctx->decimate != NULL;
+
+  while (reader->packet >= reader->num_packets) {
+    int ret = load_block(reader);
+    if (ret <= 0)
+      return ret;
+  }
+
+  libklv_reset(ctx);
+
+  if (get_varint(&reader->packets, reader->packets_end, &index) < 0 || index >= reader->num_shapes)
+    return -1;
+  const uint8_t *shape = reader->shape_ptr[index];
+  const uint8_t *shape_end = shape + reader->shape_len[index];
+
+  /* room for every integer of the packet, so item raw pointers stay put while it is rebuilt */
+  size_t values_size = 0;
+  size_t set_size = 0;
+  for (const uint8_t *p = shape; p < shape_end;) {
+    uint8_t id = *p++;
+    uint64_t len = 0;
+    if (get_varint(&p, shape_end, &len) < 0 || len > LIBKLV_MAX_PACKET_SIZE)
+      return -1;
+    if (int_desc(id, (size_t)len) != NULL)
+      values_size += (size_t)len;
+    set_size += 1 + 9 + (size_t)len; /* tag, longest BER length, value */
+  }
+  if (values_size > reader->values_capacity) {
+    uint8_t *tmp = (uint8_t *)realloc(reader->values, values_size);
+    if (tmp == NULL)
+      return -1;
+    reader->values = tmp;
+    reader->values_capacity = values_size;
+  }
+  if (rebuild_set && set_size > reader->local_set_capacity) {
+    uint8_t *tmp = (uint8_t *)realloc(reader->local_set, set_size);
+    if (tmp == NULL)
+      return -1;
+    reader->local_set = tmp;
+    reader->local_set_capacity = set_size;
+  }
+
+  uint8_t *values = reader->values;
+  uint8_t *set = reader->local_set;
+  for (const uint8_t *p = shape; p < shape_end;) {
+    uint8_t id = *p++;
+    uint64_t len = 0;
+    uint64_t v = 0;
+    get_varint(&p, shape_end, &len);
+
+    archive_column_t *column = &reader->columns[id];
+    if (get_varint(&column->ptr, column->end, &v) < 0)
+      return -1;
+
+    const klv_tag_desc_t *desc = int_desc(id, (size_t)len);
+    if (desc != NULL) {
+      column->prev += (uint64_t)unzigzag(v);
+      for (int i = 0; i < desc->len; i++)
+        values[i] = (uint8_t)(column->prev >> (8 * (desc->len - 1 - i)));
+      memset(values + desc->len, 0, (size_t)len - desc->len);
+      if (libklv_add_item(ctx, id, values, (size_t)len) == NULL)
+        return -1;
+      if (rebuild_set)
+        set = put_item(set, id, values, (size_t)len);
+      values += len;
+    } else {
+      if (v >= reader->num_strings || reader->string_len[v] != len)
+        return -1;
+      if (libklv_add_item(ctx, id, reader->string_ptr[v], reader->string_len[v]) == NULL)
+        return -1;
+      if (rebuild_set)
+        set = put_item(set, id, reader->string_ptr[v], reader->string_len[v]);
+    }
+  }
+  reader->local_set_len = rebuild_set ? (size_t)(set - reader->local_set) : 0;
+
+  reader->packet++;
+  return 1;
+}
+
+/*****************************************************************************
+ * libklv_archive_read_packet
+ *
+ * Rebuild the next packet's items in ctx->klv_items, recycling the previous
+ * ones, exactly as libklv_parse_data would have decoded them. String and
+ * opaque items point into the archive buffer, integers into the reader.
+ * Packets are passed through ctx's filter, dedup and decimate in the same
+ * order as there, dedup and decimate seeing the local set rebuilt from the
+ * archived values. Returns 1 for a packet, 0 at the end of the archive and
+ * -1 on error.
+ *****************************************************************************/
+int libklv_archive_read_packet(klv_archive_reader_t *reader, klv_ctx_t *ctx) {
+  int ret;
+
+  while ((ret = read_packet(reader, ctx)) > 0) {
+    struct list_head *items = &ctx->klv_items.list;
+    if (ctx->filter != NULL && !libklv_filter_match_items(ctx->filter, items->next, items))
+      continue;
+    if (ctx->dedup != NULL && libklv_dedup_seen(ctx->dedup, reader->local_set, reader->local_set_len))
+      continue;
+    if (ctx->decimate != NULL && !libklv_decimate_keep(ctx->decimate, reader->local_set, reader->local_set_len))
+      continue;
+    break;
+  }
+  return ret;
+}
+
+/*****************************************************************************
+ * libklv_archive_seek
+ *
+ * Position the reader at the first block that can hold timestamp, i.e. whose
+ * last precision time stamp is not earlier, assuming blocks are in time
+ * order. Packets before timestamp in that block are still returned. Returns
+ * 1 when positioned, 0 when every block is earlier, -1 on error.
+ *****************************************************************************/
+int libklv_archive_seek(klv_archive_reader_t *reader, uint64_t timestamp) {
+  if (reader->blocks == NULL) {
+    size_t capacity = 64;
+    reader->blocks = (archive_block_t *)malloc(capacity * sizeof(archive_block_t));
+    if (reader->blocks == NULL)
+      return -1;
+
+    /* hop from header to header, payloads are not touched */
+    size_t offset = 0;
+    while (reader->size - offset >= LIBKLV_ARCHIVE_HEADER_SIZE) {
+      const uint8_t *header = reader->data + offset;
+      if (memcmp(header, LIBKLV_ARCHIVE_MAGIC, 4) != 0)
+        break;
+      if (reader->num_blocks == capacity) {
+        archive_block_t *tmp = (archive_block_t *)realloc(reader->blocks, 2 * capacity * sizeof(archive_block_t));
+        if (tmp == NULL)
+          return -1;
+        reader->blocks = tmp;
+        capacity *= 2;
+      }
+      archive_block_t *block = &reader->blocks[reader->num_blocks++];
+      block->offset = offset;
+      block->first_time = get_le(header + 16, 8);
+      block->last_time = get_le(header + 24, 8);
+      uint64_t payload_size = get_le(header + 8, 4);
+      if (payload_size > reader->size - offset - LIBKLV_ARCHIVE_HEADER_SIZE)
+        break;
+      offset += LIBKLV_ARCHIVE_HEADER_SIZE + (size_t)payload_size;
+    }
+  }
+
+  size_t lo = 0;
+  size_t hi = reader->num_blocks;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (reader->blocks[mid].last_time < timestamp)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  reader->num_packets = 0;
+  reader->packet = 0;
+  if (lo == reader->num_blocks) {
+    reader->next_block = reader->size;
+    return 0;
+  }
+  reader->next_block = reader->blocks[lo].offset;
+  return 1;
+}
+
+/*****************************************************************************
+ * libklv_archive_reader_cleanup
+ *****************************************************************************/
+void libklv_archive_reader_cleanup(klv_archive_reader_t *reader) {
+  if (reader != NULL) {
+    free(reader->string_ptr);
+    free(reader->string_len);
+    free(reader->values);
+    free(reader->local_set);
+    free(reader->blocks);
+    free(reader);
+  }
+}
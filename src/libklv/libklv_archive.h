@@ -0,0 +1,56 @@
+#ifndef LIBKLV_ARCHIVE_H_INCLUDED
+#define LIBKLV_ARCHIVE_H_INCLUDED
+
+#include "libklv.h"
+
+#define LIBKLV_ARCHIVE_MAGIC "KLVA"
+#define LIBKLV_ARCHIVE_VERSION 1
+#define LIBKLV_ARCHIVE_HEADER_SIZE 32
+#define LIBKLV_ARCHIVE_BLOCK_PACKETS 4096 /* packets per block; blocks are the unit of seeking */
+
+/*
+ * An archive is a sequence of self-contained blocks, so archives can be
+ * concatenated and a reader can start at any block. Each block is a header
+ * followed by payload_size bytes:
+ *
+ *   header, little-endian:
+ *     char     magic[4]      "KLVA"
+ *     uint8_t  version
+ *     uint8_t  reserved[3]
+ *     uint32_t payload_size
+ *     uint32_t num_packets
+ *     uint64_t first_time    precision time stamp (0x02) of the first packet carrying one, 0 if none
+ *     uint64_t last_time     ... of the last packet carrying one
+ *
+ *   payload, every count and length an unsigned LEB128 varint:
+ *     shapes:  count, then per shape its length and (id, varint item length) pairs
+ *     strings: count, then per entry its length and bytes
+ *     packets: length, then one shape index per packet
+ *     columns: count, then per column id, length and stream
+ *
+ * A shape is the ordered list of (tag, length) of a packet; consecutive
+ * packets almost always share one. Integer tags are stored per tag as the
+ * zig-zag varint delta of the raw integer from its previous value in the
+ * block. Strings, opaque values and unknown tags are stored as varint indexes
+ * into the block's string dictionary. Integer values longer than their
+ * encoded width keep only the bytes the decoder reads.
+ */
+
+typedef struct klv_archive_writer_s klv_archive_writer_t;
+typedef struct klv_archive_reader_s klv_archive_reader_t;
+
+/*
+ * Global prototypes
+ */
+klv_archive_writer_t *libklv_archive_writer_init(FILE *out);
+int libklv_archive_write_packet(klv_archive_writer_t *writer, const struct list_head *first, const struct list_head *end);
+int libklv_archive_flush(klv_archive_writer_t *writer);
+int libklv_archive_writer_finish(klv_archive_writer_t *writer);
+
+bool libklv_is_archive(const uint8_t *data, size_t size);
+klv_archive_reader_t *libklv_archive_reader_init(const uint8_t *data, size_t size);
+int libklv_archive_read_packet(klv_archive_reader_t *reader, klv_ctx_t *ctx);
+int libklv_archive_seek(klv_archive_reader_t *reader, uint64_t timestamp);
+void libklv_archive_reader_cleanup(klv_archive_reader_t *reader);
+
+#endif // LIBKLV_ARCHIVE_H_INCLUDED
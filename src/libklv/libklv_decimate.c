@@ -0,0 +1,195 @@
+#include "libklv_decimate.h"
+#include <math.h>
+#include <string.h>
+
+#define METERS_PER_DEGREE 111195.08         /* along a great circle, mean earth radius */
+#define RADIANS_PER_DEGREE 0.017453292519943295
+#define LATITUDE_SCALE (90.0 / INT32_MAX)   /* degrees per raw unit of 0x0D */
+#define LONGITUDE_SCALE (180.0 / INT32_MAX) /* degrees per raw unit of 0x0E */
+
+/* the fields of one packet the decision needs, read from its bytes */
+typedef struct decimate_fields_s {
+  bool has_time;
+  bool has_latitude;
+  bool has_longitude;
+  bool has_heading;
+  uint64_t time;
+  int32_t latitude;
+  int32_t longitude;
+  uint16_t heading;
+} decimate_fields_t;
+
+/*****************************************************************************
+ * read_be
+ *****************************************************************************/
+static inline uint64_t read_be(const uint8_t *p, int len) {
+  uint64_t v = 0;
+  for (int i = 0; i < len; i++)
+    v = v << 8 | p[i];
+  return v;
+}
+
+/*****************************************************************************
+ * read_fields
+ *
+ * Walk the local set once, stopping as soon as every field was found. Out
+ * of range positions (the most negative integer) count as missing.
+ *****************************************************************************/
+static void read_fields(const uint8_t *p, size_t len, decimate_fields_t *f) {
+  const uint8_t *end = p + len;
+  int missing = 4;
+
+  while (missing > 0 && p + 2 <= end) {
+    uint8_t id = *p++;
+    uint64_t size = *p++;
+    if (size & 0x80) { /* long form */
+      int bytes_num = size & 0x7f;
+      if (bytes_num > 8 || bytes_num > end - p)
+        return;
+      size = 0;
+      while (bytes_num--)
+        size = size << 8 | *p++;
+    }
+    if (size > (uint64_t)(end - p))
+      return; /* truncated item */
+
+    switch (id) {
+    case 0x02: /* precision time stamp */
+      if (size >= 8 && !f->has_time) {
+        f->time = read_be(p, 8);
+        f->has_time = true;
+        missing--;
+      }
+      break;
+    case 0x05: /* platform heading angle */
+      if (size >= 2 && !f->has_heading) {
+        f->heading = (uint16_t)read_be(p, 2);
+        f->has_heading = true;
+        missing--;
+      }
+      break;
+    case 0x0D: /* sensor latitude */
+      if (size >= 4 && !f->has_latitude) {
+        f->latitude = (int32_t)(uint32_t)read_be(p, 4);
+        f->has_latitude = (f->latitude != INT32_MIN);
+        missing--;
+      }
+      break;
+    case 0x0E: /* sensor longitude */
+      if (size >= 4 && !f->has_longitude) {
+        f->longitude = (int32_t)(uint32_t)read_be(p, 4);
+        f->has_longitude = (f->longitude != INT32_MIN);
+        missing--;
+      }
+      break;
+    }
+    p += size;
+  }
+}
+
+/*****************************************************************************
+ * moved
+ *
+ * Whether the packet is far enough from the last kept one. Without a
+ * movement threshold every packet is.
+ *****************************************************************************/
+static bool moved(const klv_decimate_t *decimate, const decimate_fields_t *f) {
+  if (decimate->min_distance_sq < 0.0 && decimate->min_turn < 0)
+    return true;
+
+  if (decimate->min_distance_sq >= 0.0 && f->has_latitude && f->has_longitude) {
+    if (!decimate->has_position)
+      return true;
+    int64_t dlon = (int64_t)f->longitude - decimate->longitude;
+    if (dlon > INT32_MAX) /* across the antimeridian */
+      dlon -= 2 * (int64_t)INT32_MAX;
+    else if (dlon < -(int64_t)INT32_MAX)
+      dlon += 2 * (int64_t)INT32_MAX;
+    double dy = (double)((int64_t)f->latitude - decimate->latitude) * (LATITUDE_SCALE * METERS_PER_DEGREE);
+    double dx = (double)dlon * decimate->longitude_scale;
+    if (dx * dx + dy * dy > decimate->min_distance_sq)
+      return true;
+  }
+
+  if (decimate->min_turn >= 0 && f->has_heading) {
+    if (!decimate->has_heading)
+      return true;
+    uint16_t turn = (uint16_t)(f->heading - decimate->heading);
+    if (turn > 0x8000)
+      turn = (uint16_t)(0x10000 - turn); /* the shorter way round */
+    if (turn > decimate->min_turn)
+      return true;
+  }
+  return false;
+}
+
+/*****************************************************************************
+ * libklv_decimate_init
+ *
+ * Keep at most rate packets per second of stream time, 0 for any number.
+ * A negative min_distance (meters) or min_turn (degrees) leaves that
+ * movement untested; with both negative, movement is not required.
+ *****************************************************************************/
+void libklv_decimate_init(klv_decimate_t *decimate, double rate, double min_distance, double min_turn) {
+  memset(decimate, 0, sizeof(*decimate));
+  decimate->interval = (rate > 0.0) ? (uint64_t)(1e6 / rate) : 0;
+  decimate->min_distance_sq = (min_distance >= 0.0) ? min_distance * min_distance : -1.0;
+  /* an integer number of raw units is more than min_turn degrees when it is more than this floor */
+  if (min_turn < 0.0)
+    decimate->min_turn = -1;
+  else
+    decimate->min_turn = (min_turn < 180.0) ? (int32_t)floor(min_turn * UINT16_MAX / 360.0) : 0x8000;
+}
+
+/*****************************************************************************
+ * libklv_decimate_reset
+ *
+ * Forget the last kept packet, for a stream that starts over, so that its
+ * first packet is kept again.
+ *****************************************************************************/
+void libklv_decimate_reset(klv_decimate_t *decimate) {
+  decimate->has_kept = false;
+  decimate->has_time = false;
+  decimate->has_position = false;
+  decimate->has_heading = false;
+}
+
+/*****************************************************************************
+ * libklv_decimate_keep
+ *
+ * Whether to keep the packet whose local set payload, the bytes after its key
+ * and length, is given. Remembers it as the last kept packet if so.
+ *****************************************************************************/
+bool libklv_decimate_keep(klv_decimate_t *decimate, const uint8_t *payload, size_t len) {
+  decimate_fields_t f = {0};
+
+  read_fields(payload, len, &f);
+
+  if (decimate->has_kept) {
+    /* a time stamp going backwards starts a new interval */
+    bool early = decimate->interval > 0 && f.has_time && decimate->has_time && f.time >= decimate->time &&
+                 f.time - decimate->time < decimate->interval;
+    if (early || !moved(decimate, &f)) {
+      decimate->dropped++;
+      return false;
+    }
+  }
+
+  decimate->has_kept = true;
+  if (f.has_time) {
+    decimate->time = f.time;
+    decimate->has_time = true;
+  }
+  if (f.has_latitude && f.has_longitude) {
+    decimate->latitude = f.latitude;
+    decimate->longitude = f.longitude;
+    decimate->longitude_scale = LONGITUDE_SCALE * METERS_PER_DEGREE * cos(f.latitude * LATITUDE_SCALE * RADIANS_PER_DEGREE);
+    decimate->has_position = true;
+  }
+  if (f.has_heading) {
+    decimate->heading = f.heading;
+    decimate->has_heading = true;
+  }
+  decimate->kept++;
+  return true;
+}
@@ -0,0 +1,48 @@
+#ifndef LIBKLV_DECIMATE_H_INCLUDED
+#define LIBKLV_DECIMATE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Thins a stream out before it is decoded, for consumers that need far fewer
+ * packets than the platform sends. A packet is kept when
+ *
+ *   - at least interval microseconds of precision time stamp (0x02) have
+ *     passed since the last kept packet, and
+ *   - when a movement threshold is set, the sensor position (0x0D, 0x0E) has
+ *     moved more than min_distance meters or the platform heading (0x05) has
+ *     turned more than min_turn degrees since the last kept packet.
+ *
+ * Both are decided on the raw integers in the packet bytes. The thresholds
+ * are converted to raw units once, and the meters per raw longitude unit
+ * only when a packet is kept. A packet without a time stamp passes the rate
+ * limit, and one without a position or heading fails the movement test on
+ * that field. The first packet is always kept.
+ */
+typedef struct klv_decimate_s {
+  uint64_t interval;        /* least microseconds between kept packets, 0 for no rate limit */
+  double min_distance_sq;   /* squared meters of movement, negative when not tested */
+  int32_t min_turn;         /* raw heading change, negative when not tested */
+  bool has_kept;            /* a packet was kept, so the fields below are set */
+  bool has_time;            /* the last kept packet with a time stamp */
+  uint64_t time;
+  bool has_position;        /* the last kept position */
+  int32_t latitude;
+  int32_t longitude;
+  double longitude_scale;   /* meters per raw longitude unit at latitude */
+  bool has_heading;         /* the last kept heading */
+  uint16_t heading;
+  uint64_t kept;            /* packets kept */
+  uint64_t dropped;         /* packets dropped */
+} klv_decimate_t;
+
+/*
+ * Global prototypes
+ */
+void libklv_decimate_init(klv_decimate_t *decimate, double rate, double min_distance, double min_turn);
+void libklv_decimate_reset(klv_decimate_t *decimate);
+bool libklv_decimate_keep(klv_decimate_t *decimate, const uint8_t *payload, size_t len);
+
+#endif // LIBKLV_DECIMATE_H_INCLUDED
@@ -0,0 +1,134 @@
+#include "libklv_dedup.h"
+#include "libklv.h"
+
+#define HASH_PRIME UINT64_C(0x9E3779B97F4A7C15)
+#define SLOT_MASK (LIBKLV_DEDUP_SLOTS - 1)
+
+/*****************************************************************************
+ * mix
+ *****************************************************************************/
+static inline uint64_t mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= UINT64_C(0xFF51AFD7ED558CCD);
+  x ^= x >> 33;
+  return x;
+}
+
+/*****************************************************************************
+ * hash_bytes
+ *
+ * Eight bytes per step; only compared within one process, so the host byte
+ * order does not matter.
+ *****************************************************************************/
+static uint64_t hash_bytes(const uint8_t *p, size_t len) {
+  uint64_t h = HASH_PRIME ^ len;
+  uint64_t w;
+
+  for (; len >= 8; p += 8, len -= 8) {
+    memcpy(&w, p, 8);
+    h = (h ^ mix(w)) * HASH_PRIME;
+  }
+  w = 0;
+  memcpy(&w, p, len);
+  h = mix((h ^ mix(w)) * HASH_PRIME);
+  return (h != 0) ? h : 1; /* 0 marks an empty slot */
+}
+
+/*****************************************************************************
+ * payload_time
+ *
+ * Precision time stamp of a local set, read from its bytes.
+ *****************************************************************************/
+static bool payload_time(const uint8_t *p, size_t len, uint64_t *time) {
+  const uint8_t *end = p + len;
+
+  while (p + 2 <= end) {
+    uint8_t id = *p++;
+    uint64_t size = *p++;
+    if (size & 0x80) { /* long form */
+      int bytes_num = size & 0x7f;
+      if (bytes_num > 8 || bytes_num > end - p)
+        return false;
+      size = 0;
+      while (bytes_num--)
+        size = size << 8 | *p++;
+    }
+    if (size > (uint64_t)(end - p))
+      return false;
+
+    if (id == 0x02 && size == 8) {
+      *time = 0;
+      for (int i = 0; i < 8; i++)
+        *time = *time << 8 | p[i];
+      return true;
+    }
+    p += size;
+  }
+  return false;
+}
+
+/*****************************************************************************
+ * find
+ *
+ * Slot of h in generation g, or the empty slot where it would go.
+ *****************************************************************************/
+static inline size_t find(const klv_dedup_t *dedup, int g, uint64_t h) {
+  size_t i = (size_t)h & SLOT_MASK;
+
+  while (dedup->hashes[g][i] != 0 && dedup->hashes[g][i] != h)
+    i = (i + 1) & SLOT_MASK;
+  return i;
+}
+
+/*****************************************************************************
+ * libklv_dedup_init
+ *****************************************************************************/
+void libklv_dedup_init(klv_dedup_t *dedup, uint64_t window) {
+  memset(dedup, 0, sizeof(*dedup));
+  dedup->window = window;
+}
+
+/*****************************************************************************
+ * libklv_dedup_reset
+ *
+ * Forget the packets seen so far, for a stream that starts over, keeping the
+ * window and the count of duplicates.
+ *****************************************************************************/
+void libklv_dedup_reset(klv_dedup_t *dedup) {
+  uint64_t duplicates = dedup->duplicates;
+
+  libklv_dedup_init(dedup, dedup->window);
+  dedup->duplicates = duplicates;
+}
+
+/*****************************************************************************
+ * libklv_dedup_seen
+ *
+ * Whether the local set payload of a packet, the bytes after its key and
+ * length, was seen recently. Remembers it if not.
+ *****************************************************************************/
+bool libklv_dedup_seen(klv_dedup_t *dedup, const uint8_t *payload, size_t len) {
+  uint64_t h = hash_bytes(payload, len);
+  int g = dedup->current;
+
+  if (dedup->hashes[g][find(dedup, g, h)] == h || dedup->hashes[!g][find(dedup, !g, h)] == h) {
+    dedup->duplicates++;
+    return true;
+  }
+
+  uint64_t time;
+  if (payload_time(payload, len, &time) && time > dedup->time)
+    dedup->time = time;
+
+  if (dedup->time - dedup->generation_start >= dedup->window || dedup->count[g] >= LIBKLV_DEDUP_SLOTS / 4 * 3) {
+    /* the current generation becomes the previous one, forgetting the oldest */
+    g = dedup->current = !g;
+    memset(dedup->hashes[g], 0, sizeof(dedup->hashes[g]));
+    dedup->count[g] = 0;
+    dedup->generation_start = dedup->time;
+  }
+
+  dedup->hashes[g][find(dedup, g, h)] = h;
+  dedup->count[g]++;
+  return false;
+}
@@ -0,0 +1,39 @@
+#ifndef LIBKLV_DEDUP_H_INCLUDED
+#define LIBKLV_DEDUP_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LIBKLV_DEDUP_SLOTS 8192 /* hash slots per generation, a power of two */
+
+/*
+ * Recognizes packets that were already seen, for feeds merged from redundant
+ * links, before they are decoded. Packets are identified by a 64-bit hash of
+ * their local set bytes, which include the precision time stamp and checksum.
+ *
+ * Hashes are kept in two generations of an open-addressing set. The current
+ * generation becomes the previous one, and the previous one is dropped, once
+ * it spans window microseconds of precision time stamp (0x02) or is 3/4 full.
+ * A copy arriving within window of the original is therefore always caught,
+ * as long as fewer than 3/4 of LIBKLV_DEDUP_SLOTS packets arrive in between.
+ * All state is fixed size, so checking never allocates.
+ */
+typedef struct klv_dedup_s {
+  uint64_t window;           /* microseconds of stream time a generation spans */
+  uint64_t time;             /* latest time stamp seen */
+  uint64_t generation_start; /* time stamp at which the current generation started */
+  int current;               /* index of the current generation in hashes */
+  uint32_t count[2];         /* hashes in each generation */
+  uint64_t duplicates;       /* packets recognized as copies */
+  uint64_t hashes[2][LIBKLV_DEDUP_SLOTS]; /* 0 marks an empty slot */
+} klv_dedup_t;
+
+/*
+ * Global prototypes
+ */
+void libklv_dedup_init(klv_dedup_t *dedup, uint64_t window);
+void libklv_dedup_reset(klv_dedup_t *dedup);
+bool libklv_dedup_seen(klv_dedup_t *dedup, const uint8_t *payload, size_t len);
+
+#endif // LIBKLV_DEDUP_H_INCLUDED
@@ -0,0 +1,219 @@
+#include "libklv_encode.h"
+#include <math.h>
+
+/*****************************************************************************
+ * libklv_writeBE
+ *****************************************************************************/
+static inline void libklv_writeBE(klv_encoder_t *enc, uint64_t value, uint8_t len) {
+  for (int shift = 8 * (len - 1); shift >= 0; shift -= 8)
+    *enc->buf_ptr++ = (uint8_t)(value >> shift);
+}
+
+/*****************************************************************************
+ * libklv_ber_size
+ *****************************************************************************/
+static inline uint8_t libklv_ber_size(size_t len) {
+  uint8_t size = 1;
+  if (len >= 0x80) { /* long form: 0x80 | byte count, then the length */
+    for (size_t tmp = len; tmp != 0; tmp >>= 8)
+      size++;
+  }
+  return size;
+}
+
+/*****************************************************************************
+ * libklv_write_ber
+ *****************************************************************************/
+static inline void libklv_write_ber(klv_encoder_t *enc, size_t len, uint8_t size) {
+  if (size == 1) {
+    *enc->buf_ptr++ = (uint8_t)len;
+  } else {
+    *enc->buf_ptr++ = (uint8_t)(0x80 | (size - 1));
+    libklv_writeBE(enc, len, size - 1);
+  }
+}
+
+/*****************************************************************************
+ * libklv_reserve
+ *
+ * Make sure len more bytes fit. Once a write has failed the encoder stays in
+ * the overflow state so a half-written packet is never returned.
+ *****************************************************************************/
+static inline bool libklv_reserve(klv_encoder_t *enc, size_t len) {
+  if (enc->overflow || (size_t)(enc->buf_end - enc->buf_ptr) < len) {
+    enc->overflow = true;
+    return false;
+  }
+  return true;
+}
+
+/*****************************************************************************
+ * libklv_encode_raw
+ *****************************************************************************/
+static int libklv_encode_raw(klv_encoder_t *enc, uint8_t id, uint64_t raw, uint8_t len) {
+  if (!libklv_reserve(enc, 2 + len))
+    return -1;
+  *enc->buf_ptr++ = id;
+  *enc->buf_ptr++ = len;
+  libklv_writeBE(enc, raw, len);
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_encode_begin
+ *****************************************************************************/
+void libklv_encode_begin(klv_encoder_t *enc, uint8_t *buffer, size_t size) {
+  enc->buffer = buffer;
+  enc->buf_ptr = buffer;
+  enc->buf_end = buffer + size;
+  enc->overflow = false;
+
+  if (libklv_reserve(enc, sizeof(klv_universal_key) + LIBKLV_BER_RESERVE)) {
+    memcpy(enc->buf_ptr, klv_universal_key, sizeof(klv_universal_key));
+    /* the BER length is written once the payload size is known */
+    enc->buf_ptr += sizeof(klv_universal_key) + LIBKLV_BER_RESERVE;
+  }
+}
+
+/*****************************************************************************
+ * libklv_encode_value
+ *
+ * Quantize a mapped value into the tag's integer range. This is the inverse
+ * of libklv_map_val; values outside the tag's range are clamped and NaN is
+ * rejected.
+ *****************************************************************************/
+int libklv_encode_value(klv_encoder_t *enc, uint8_t id, double value) {
+  const klv_tag_desc_t *desc = libklv_tag_desc(id);
+  if (desc == NULL || (desc->type != KLV_TYPE_UINT && desc->type != KLV_TYPE_INT))
+    return -1;
+
+  double raw_min = libklv_tag_raw_min(desc);
+  double raw_max = libklv_tag_raw_max(desc);
+  double raw = value;
+  if (desc->min < desc->max)
+    raw = raw_min + ((value - desc->min) * (raw_max - raw_min) / (desc->max - desc->min));
+  if (isnan(raw))
+    return -1;
+  if (raw < raw_min)
+    raw = raw_min;
+  if (raw > raw_max)
+    raw = raw_max;
+
+  /* the limits of 8-byte tags are rounded to 2^63 and 2^64 as doubles, past any integer */
+  if (desc->type == KLV_TYPE_INT) {
+    int64_t limit = INT64_MAX >> (64 - 8 * desc->len);
+    int64_t v = (raw >= 0x1p63) ? limit : (raw <= -0x1p63) ? -limit : llround(raw);
+    return libklv_encode_raw(enc, id, (uint64_t)v, desc->len);
+  }
+  return libklv_encode_raw(enc, id, (raw >= 0x1p64) ? UINT64_MAX : (uint64_t)round(raw), desc->len);
+}
+
+/*****************************************************************************
+ * libklv_encode_uint
+ *****************************************************************************/
+int libklv_encode_uint(klv_encoder_t *enc, uint8_t id, uint64_t value) {
+  const klv_tag_desc_t *desc = libklv_tag_desc(id);
+  if (desc == NULL || desc->type != KLV_TYPE_UINT)
+    return -1;
+  return libklv_encode_raw(enc, id, value, desc->len);
+}
+
+/*****************************************************************************
+ * libklv_encode_int
+ *****************************************************************************/
+int libklv_encode_int(klv_encoder_t *enc, uint8_t id, int64_t value) {
+  const klv_tag_desc_t *desc = libklv_tag_desc(id);
+  if (desc == NULL || desc->type != KLV_TYPE_INT)
+    return -1;
+  return libklv_encode_raw(enc, id, (uint64_t)value, desc->len);
+}
+
+/*****************************************************************************
+ * libklv_encode_bytes
+ *****************************************************************************/
+int libklv_encode_bytes(klv_encoder_t *enc, uint8_t id, const void *data, size_t len) {
+  uint8_t ber_size = libklv_ber_size(len);
+  if (!libklv_reserve(enc, 1 + ber_size + len))
+    return -1;
+  *enc->buf_ptr++ = id;
+  libklv_write_ber(enc, len, ber_size);
+  memcpy(enc->buf_ptr, data, len);
+  enc->buf_ptr += len;
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_encode_string
+ *****************************************************************************/
+int libklv_encode_string(klv_encoder_t *enc, uint8_t id, const char *str) {
+  return libklv_encode_bytes(enc, id, str, strlen(str));
+}
+
+/*****************************************************************************
+ * libklv_encode_item
+ *
+ * Re-encode an item produced by libklv_parse_data, e.g. to re-mux a stream
+ * after correcting some of its values. The checksum item is skipped since
+ * libklv_encode_end writes a fresh one.
+ *****************************************************************************/
+int libklv_encode_item(klv_encoder_t *enc, const klv_item_t *item) {
+  const klv_tag_desc_t *desc = libklv_tag_desc(item->id);
+  if (desc == NULL)
+    return -1;
+
+  switch (desc->type) {
+  case KLV_TYPE_UINT:
+    if (item->id == 0x01)
+      return 0;
+    return libklv_encode_raw(enc, item->id, item->value, desc->len);
+  case KLV_TYPE_INT:
+    return libklv_encode_raw(enc, item->id, (uint64_t)item->signed_val, desc->len);
+  case KLV_TYPE_STRING:
+  case KLV_TYPE_BYTES:
+    if (item->data == NULL) /* the decoder skipped this tag, nothing to write back */
+      return -1;
+    return libklv_encode_bytes(enc, item->id, item->data, item->len);
+  default:
+    return -1;
+  }
+}
+
+/*****************************************************************************
+ * libklv_encode_end
+ *
+ * Append the checksum, fill in the BER packet length and return the size of
+ * the finished packet, which starts at the beginning of the caller's buffer.
+ * Returns 0 if the packet did not fit.
+ *****************************************************************************/
+size_t libklv_encode_end(klv_encoder_t *enc) {
+  uint8_t *payload = enc->buffer + sizeof(klv_universal_key) + LIBKLV_BER_RESERVE;
+
+  if (!libklv_reserve(enc, 4))
+    return 0;
+  *enc->buf_ptr++ = 0x01;
+  *enc->buf_ptr++ = 0x02;
+
+  size_t payload_len = (size_t)(enc->buf_ptr - payload) + 2;
+  uint8_t ber_size = libklv_ber_size(payload_len);
+  if (ber_size > LIBKLV_BER_RESERVE) {
+    enc->overflow = true;
+    return 0;
+  }
+
+  /* close the gap left by the reserved length bytes */
+  uint8_t *ber = enc->buffer + sizeof(klv_universal_key);
+  if (ber_size < LIBKLV_BER_RESERVE) {
+    memmove(ber + ber_size, payload, payload_len - 2);
+    enc->buf_ptr -= LIBKLV_BER_RESERVE - ber_size;
+  }
+
+  uint8_t *checksum = enc->buf_ptr;
+  enc->buf_ptr = ber;
+  libklv_write_ber(enc, payload_len, ber_size);
+
+  size_t packet_len = (size_t)(checksum - enc->buffer) + 2;
+  enc->buf_ptr = checksum;
+  libklv_writeBE(enc, libklv_checksum(enc->buffer, packet_len - 2), 2);
+
+  return packet_len;
+}
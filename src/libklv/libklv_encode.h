@@ -0,0 +1,29 @@
+#ifndef LIBKLV_ENCODE_H_INCLUDED
+#define LIBKLV_ENCODE_H_INCLUDED
+
+#include "libklv.h"
+#include "libklv_tags.h"
+
+/* bytes reserved after the universal key for the BER packet length (0x82 + 2 bytes) */
+#define LIBKLV_BER_RESERVE 3
+
+typedef struct klv_encoder_s {
+  uint8_t *buffer;  /* start of the caller's buffer, the packet is written here */
+  uint8_t *buf_ptr; /* next byte to write */
+  uint8_t *buf_end; /* end of the caller's buffer */
+  bool overflow;    /* set when a write did not fit; the packet is then discarded */
+} klv_encoder_t;
+
+/*
+ * Global prototypes
+ */
+void libklv_encode_begin(klv_encoder_t *enc, uint8_t *buffer, size_t size);
+int libklv_encode_value(klv_encoder_t *enc, uint8_t id, double value);
+int libklv_encode_uint(klv_encoder_t *enc, uint8_t id, uint64_t value);
+int libklv_encode_int(klv_encoder_t *enc, uint8_t id, int64_t value);
+int libklv_encode_bytes(klv_encoder_t *enc, uint8_t id, const void *data, size_t len);
+int libklv_encode_string(klv_encoder_t *enc, uint8_t id, const char *str);
+int libklv_encode_item(klv_encoder_t *enc, const klv_item_t *item);
+size_t libklv_encode_end(klv_encoder_t *enc);
+
+#endif // LIBKLV_ENCODE_H_INCLUDED
@@ -0,0 +1,290 @@
+#include "libklv_filter.h"
+#include "libklv.h"
+#include "libklv_tags.h"
+#include <math.h>
+
+#define KEY_SIGN (UINT64_C(1) << 63)
+
+/*****************************************************************************
+ * next_token
+ *
+ * Copy the next word, number or comparison operator of expr into tok.
+ * Returns its length, 0 at the end of expr and -1 if it does not fit.
+ *****************************************************************************/
+static int next_token(const char **expr, char *tok, size_t size) {
+  const char *p = *expr;
+  size_t n = 0;
+
+  while (*p == ' ' || *p == '\t')
+    p++;
+  bool op = (*p != '\0' && strchr("<>=!", *p) != NULL);
+  while (*p != '\0' && *p != ' ' && *p != '\t' && (strchr("<>=!", *p) != NULL) == op) {
+    if (n + 1 == size)
+      return -1;
+    tok[n++] = *p++;
+  }
+
+  tok[n] = '\0';
+  *expr = p;
+  return (int)n;
+}
+
+/*****************************************************************************
+ * next_number
+ *****************************************************************************/
+static int next_number(const char **expr, double *value) {
+  char tok[64];
+  char *end = NULL;
+
+  if (next_token(expr, tok, sizeof(tok)) <= 0)
+    return -1;
+  *value = strtod(tok, &end);
+  return (*end == '\0' && isfinite(*value)) ? 0 : -1;
+}
+
+/*****************************************************************************
+ * key_value
+ *
+ * Decoded value of a raw key, with the same arithmetic as the decoder's
+ * libklv_map_val so that the intervals agree with it to the last bit.
+ *****************************************************************************/
+static double key_value(const klv_tag_desc_t *desc, uint64_t key) {
+  double raw = (desc->type == KLV_TYPE_INT) ? (double)(int64_t)(key ^ KEY_SIGN) : (double)key;
+
+  if (!(desc->min < desc->max))
+    return raw;
+  double a = libklv_tag_raw_min(desc);
+  double b = libklv_tag_raw_max(desc);
+  double t = (raw - a) / (b - a);
+  return (desc->min + (t * (desc->max - desc->min)));
+}
+
+/*****************************************************************************
+ * first_key
+ *
+ * Binary search the valid keys [lo, hi] for the first whose value is >= t,
+ * or > t when strict; decoded values never decrease as keys grow.
+ *****************************************************************************/
+static bool first_key(const klv_tag_desc_t *desc, uint64_t lo, uint64_t hi, double t, bool strict, uint64_t *key) {
+  double v = key_value(desc, hi);
+  if (strict ? !(v > t) : !(v >= t))
+    return false;
+
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    v = key_value(desc, mid);
+    if (strict ? (v > t) : (v >= t))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  *key = lo;
+  return true;
+}
+
+/*****************************************************************************
+ * compile_term
+ *
+ * Parse "name op number" or "name between a and b" into a raw key interval.
+ *****************************************************************************/
+static int compile_term(klv_filter_term_t *term, const char **expr) {
+  char tok[64];
+  uint64_t key_min, key_max, key;
+  double a, b;
+
+  if (next_token(expr, tok, sizeof(tok)) <= 0)
+    return -1;
+  int id = libklv_tag_by_name(tok);
+  const klv_tag_desc_t *desc = (id >= 0) ? libklv_tag_desc((uint8_t)id) : NULL;
+  if (desc == NULL || (desc->type != KLV_TYPE_UINT && desc->type != KLV_TYPE_INT) || desc->len == 0 || desc->len > 8)
+    return -1;
+
+  term->id = (uint8_t)id;
+  term->len = desc->len;
+  term->is_signed = (desc->type == KLV_TYPE_INT);
+  if (term->is_signed) {
+    /* the most negative integer of a mapped tag decodes as out of range */
+    uint64_t half = UINT64_C(1) << (8 * desc->len - 1);
+    key_min = KEY_SIGN - half + ((desc->min < desc->max) ? 1 : 0);
+    key_max = KEY_SIGN + (half - 1);
+  } else {
+    key_min = 0;
+    key_max = (desc->len == 8) ? UINT64_MAX : (UINT64_C(1) << (8 * desc->len)) - 1;
+  }
+
+  if (next_token(expr, tok, sizeof(tok)) <= 0)
+    return -1;
+
+  bool empty = false;
+  uint64_t lo = key_min;
+  uint64_t hi = key_max;
+  bool lower = false, lower_strict = false;
+  bool upper = false, upper_strict = false;
+
+  if (strcmp(tok, "between") == 0) {
+    if (next_number(expr, &a) < 0 || next_token(expr, tok, sizeof(tok)) <= 0 || strcmp(tok, "and") != 0 || next_number(expr, &b) < 0)
+      return -1;
+    lower = upper = upper_strict = true;
+  } else {
+    if (next_number(expr, &a) < 0)
+      return -1;
+    b = a;
+    if (strcmp(tok, "<") == 0) {
+      upper = true;
+    } else if (strcmp(tok, "<=") == 0) {
+      upper = upper_strict = true;
+    } else if (strcmp(tok, ">") == 0) {
+      lower = lower_strict = true;
+    } else if (strcmp(tok, ">=") == 0) {
+      lower = true;
+    } else if (strcmp(tok, "=") == 0 || strcmp(tok, "==") == 0) {
+      lower = upper = upper_strict = true;
+    } else {
+      return -1;
+    }
+  }
+
+  /* value >= a (> a) from the first key reaching a; value < b (<= b) up to the key before the first reaching b (passing b) */
+  if (lower) {
+    if (first_key(desc, key_min, key_max, a, lower_strict, &key))
+      lo = key;
+    else
+      empty = true;
+  }
+  if (upper && first_key(desc, key_min, key_max, b, upper_strict, &key)) {
+    if (key == key_min)
+      empty = true;
+    else
+      hi = key - 1;
+  }
+
+  term->lo = empty ? 1 : lo;
+  term->hi = empty ? 0 : hi;
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_filter_compile
+ *
+ * Returns -1 on a syntax error, a tag that is unknown or not numeric, or
+ * more than LIBKLV_FILTER_MAX_TERMS comparisons.
+ *****************************************************************************/
+int libklv_filter_compile(klv_filter_t *filter, const char *expr) {
+  char tok[64];
+
+  memset(filter, 0, sizeof(*filter));
+  for (;;) {
+    if (filter->num_terms == LIBKLV_FILTER_MAX_TERMS)
+      return -1;
+    klv_filter_term_t *term = &filter->terms[filter->num_terms];
+    if (compile_term(term, &expr) < 0)
+      return -1;
+    filter->tags[term->id] = 1;
+    filter->num_terms++;
+
+    int n = next_token(&expr, tok, sizeof(tok));
+    if (n == 0 || (n > 0 && strcmp(tok, "or") == 0))
+      filter->group_end[filter->num_groups++] = filter->num_terms;
+    if (n == 0)
+      return 0;
+    if (n < 0 || (strcmp(tok, "and") != 0 && strcmp(tok, "or") != 0))
+      return -1;
+  }
+}
+
+/*****************************************************************************
+ * match_value
+ *
+ * Bits of the terms on tag id that the encoded value satisfies.
+ *****************************************************************************/
+static uint32_t match_value(const klv_filter_t *filter, uint8_t id, const uint8_t *value, size_t len) {
+  uint32_t matched = 0;
+
+  for (int i = 0; i < filter->num_terms; i++) {
+    const klv_filter_term_t *term = &filter->terms[i];
+    if (term->id != id || len < term->len) /* too short values are not decoded */
+      continue;
+
+    uint64_t key = 0;
+    for (int j = 0; j < term->len; j++)
+      key = key << 8 | value[j];
+    if (term->is_signed) {
+      uint64_t sign = UINT64_C(1) << (8 * term->len - 1);
+      key = ((key ^ sign) - sign) ^ KEY_SIGN;
+    }
+    if (key >= term->lo && key <= term->hi)
+      matched |= UINT32_C(1) << i;
+  }
+  return matched;
+}
+
+/*****************************************************************************
+ * eval_groups
+ *****************************************************************************/
+static bool eval_groups(const klv_filter_t *filter, uint32_t matched) {
+  int start = 0;
+
+  if (filter->num_groups == 0)
+    return true;
+  for (int g = 0; g < filter->num_groups; g++) {
+    uint32_t group = 0;
+    for (int i = start; i < filter->group_end[g]; i++)
+      group |= UINT32_C(1) << i;
+    if ((matched & group) == group)
+      return true;
+    start = filter->group_end[g];
+  }
+  return false;
+}
+
+/*****************************************************************************
+ * libklv_filter_match
+ *
+ * Test the local set of one packet, the payload after its key and length,
+ * without decoding it.
+ *****************************************************************************/
+bool libklv_filter_match(const klv_filter_t *filter, const uint8_t *payload, size_t len) {
+  const uint8_t *p = payload;
+  const uint8_t *end = payload + len;
+  uint32_t matched = 0;
+
+  while (p + 2 <= end) {
+    uint8_t id = *p++;
+    uint64_t size = *p++;
+    if (size & 0x80) { /* long form */
+      int bytes_num = size & 0x7f;
+      if (bytes_num > 8 || bytes_num > end - p)
+        break;
+      size = 0;
+      while (bytes_num--)
+        size = size << 8 | *p++;
+    }
+    if (size > (uint64_t)(end - p))
+      break; /* truncated item */
+
+    if (filter->tags[id])
+      matched |= match_value(filter, id, p, (size_t)size);
+    p += size;
+  }
+
+  return eval_groups(filter, matched);
+}
+
+/*****************************************************************************
+ * libklv_filter_match_items
+ *
+ * Test the items [first, end) of a packet that is already decoded, e.g. read
+ * back from an archive.
+ *****************************************************************************/
+bool libklv_filter_match_items(const klv_filter_t *filter, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+  uint32_t matched = 0;
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    if (filter->tags[item->id] && item->raw != NULL)
+      matched |= match_value(filter, item->id, item->raw, item->raw_len);
+  }
+
+  return eval_groups(filter, matched);
+}
@@ -0,0 +1,52 @@
+#ifndef LIBKLV_FILTER_H_INCLUDED
+#define LIBKLV_FILTER_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+#define LIBKLV_FILTER_MAX_TERMS 32
+
+/*
+ * One comparison, converted to the interval of encoded integers whose decoded
+ * value satisfies it. Keys are the big-endian raw integers, with the sign bit
+ * flipped for signed tags so that both compare as unsigned.
+ */
+typedef struct klv_filter_term_s {
+  uint8_t id;  /* ST0601 tag */
+  uint8_t len; /* encoded width, bytes read from the value */
+  bool is_signed;
+  uint64_t lo; /* accepted keys, inclusive; lo > hi never matches */
+  uint64_t hi;
+} klv_filter_term_t;
+
+/*
+ * A packet filter such as
+ *
+ *   sensor_latitude between 45 and 46 and platform_heading < 90 or sensor_true_altitude > 5000
+ *
+ * restricted to numeric tags: comparisons (<, <=, >, >=, =) and
+ * "between a and b" on tag names from libklv_tags, joined by "and" and "or"
+ * with "and" binding tighter. Thresholds are on the decoded value and are
+ * converted once to raw integer intervals, so packets are tested on their
+ * encoded bytes before anything is decoded. A comparison on a tag the packet
+ * lacks, or whose value is out of range, is false.
+ */
+typedef struct klv_filter_s {
+  uint8_t num_terms;
+  klv_filter_term_t terms[LIBKLV_FILTER_MAX_TERMS];
+  uint8_t num_groups;
+  uint8_t group_end[LIBKLV_FILTER_MAX_TERMS]; /* terms of group g end at group_end[g]; groups are or-ed */
+  uint8_t tags[256];                          /* 1 for tags some term tests */
+} klv_filter_t;
+
+/*
+ * Global prototypes
+ */
+int libklv_filter_compile(klv_filter_t *filter, const char *expr);
+bool libklv_filter_match(const klv_filter_t *filter, const uint8_t *payload, size_t len);
+bool libklv_filter_match_items(const klv_filter_t *filter, const struct list_head *first, const struct list_head *end);
+
+#endif // LIBKLV_FILTER_H_INCLUDED
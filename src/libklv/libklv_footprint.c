@@ -0,0 +1,330 @@
+#include "libklv_footprint.h"
+#include "libklv.h"
+#include <inttypes.h>
+
+/* columns gathered per frame */
+enum {
+  FP_CENTER = 0,  /* 0x17, 0x18: frame center latitude, longitude */
+  FP_OFFSET = 2,  /* 0x1A-0x21: offset corner latitude, longitude 1-4 */
+  FP_CORNER = 10, /* 0x52-0x59: corner latitude, longitude 1-4 */
+  FP_FIELDS = 18,
+};
+
+#define FP_CENTER_MASK ((UINT32_C(1) << FP_OFFSET) - 1)
+#define FP_OFFSET_MASK (((UINT32_C(1) << FP_CORNER) - 1) & ~FP_CENTER_MASK)
+#define FP_CORNER_MASK (((UINT32_C(1) << FP_FIELDS) - 1) & ~(FP_CENTER_MASK | FP_OFFSET_MASK))
+
+#define FP_RING_POINTS 9 /* a corner ring clipped at the antimeridian, closed */
+
+/* one closed ring of a frame's polygon */
+typedef struct {
+  int count;
+  double lon[FP_RING_POINTS];
+  double lat[FP_RING_POINTS];
+} fp_ring_t;
+
+struct klv_footprint_s {
+  size_t count; /* frames gathered */
+  uint64_t time[LIBKLV_FOOTPRINT_BATCH];
+  uint8_t has_time[LIBKLV_FOOTPRINT_BATCH];
+  uint8_t use_offsets[LIBKLV_FOOTPRINT_BATCH]; /* 1 when the corners are offsets from the center */
+  int32_t center[2][LIBKLV_FOOTPRINT_BATCH];   /* raw center latitude, longitude; 0 for full corners */
+  int32_t corner[8][LIBKLV_FOOTPRINT_BATCH];   /* raw corner latitude, longitude 1-4, full or offsets */
+  double lat[4][LIBKLV_FOOTPRINT_BATCH];
+  double lon[4][LIBKLV_FOOTPRINT_BATCH];
+};
+
+/*****************************************************************************
+ * field_index
+ *****************************************************************************/
+static int field_index(uint8_t id) {
+  if (id == 0x17 || id == 0x18)
+    return FP_CENTER + (id - 0x17);
+  if (id >= 0x1A && id <= 0x21)
+    return FP_OFFSET + (id - 0x1A);
+  if (id >= 0x52 && id <= 0x59)
+    return FP_CORNER + (id - 0x52);
+  return -1;
+}
+
+/*****************************************************************************
+ * map_val
+ *
+ * The decoder's libklv_map_val without the range check, done when gathering.
+ *****************************************************************************/
+static inline double map_val(double value, double a, double b, double targetA, double targetB) {
+  double t = (value - a) / (b - a);
+  return (targetA + (t * (targetB - targetA)));
+}
+
+/*****************************************************************************
+ * libklv_footprint_init
+ *****************************************************************************/
+klv_footprint_t *libklv_footprint_init(void) {
+  return (klv_footprint_t *)calloc(1, sizeof(klv_footprint_t));
+}
+
+/*****************************************************************************
+ * libklv_footprint_add
+ *
+ * Gather the corner fields of one decoded packet, computing and writing the
+ * batch once it is full.
+ *****************************************************************************/
+int libklv_footprint_add(klv_footprint_t *footprint, FILE *out, uint8_t format, const struct list_head *first,
+                         const struct list_head *end) {
+  const struct list_head *pos;
+  int32_t v[FP_FIELDS];
+  uint32_t seen = 0;
+  size_t n = footprint->count;
+
+  footprint->has_time[n] = 0;
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    if (item->raw == NULL)
+      continue;
+
+    if (item->id == 0x02 && item->raw_len >= 8) { /* precision time stamp */
+      footprint->time[n] = item->value;
+      footprint->has_time[n] = 1;
+      continue;
+    }
+
+    int index = field_index(item->id);
+    size_t width = (index >= FP_OFFSET && index < FP_CORNER) ? 2 : 4;
+    if (index < 0 || item->raw_len < width)
+      continue;
+
+    uint32_t raw = 0;
+    for (size_t i = 0; i < width; i++)
+      raw = raw << 8 | item->raw[i];
+    uint32_t sign = UINT32_C(1) << (8 * width - 1);
+    if (raw == sign)
+      continue; /* the most negative integer is the out-of-range marker */
+    v[index] = (int32_t)((raw ^ sign) - sign);
+    seen |= UINT32_C(1) << index;
+  }
+
+  if ((seen & FP_CORNER_MASK) == FP_CORNER_MASK) {
+    footprint->use_offsets[n] = 0;
+    footprint->center[0][n] = footprint->center[1][n] = 0;
+    for (int k = 0; k < 8; k++)
+      footprint->corner[k][n] = v[FP_CORNER + k];
+  } else if ((seen & (FP_CENTER_MASK | FP_OFFSET_MASK)) == (FP_CENTER_MASK | FP_OFFSET_MASK)) {
+    footprint->use_offsets[n] = 1;
+    footprint->center[0][n] = v[FP_CENTER];
+    footprint->center[1][n] = v[FP_CENTER + 1];
+    for (int k = 0; k < 8; k++)
+      footprint->corner[k][n] = v[FP_OFFSET + k];
+  } else {
+    return 0; /* no footprint in this packet */
+  }
+
+  if (++footprint->count == LIBKLV_FOOTPRINT_BATCH)
+    return libklv_footprint_flush(footprint, out, format);
+  return 0;
+}
+
+/*****************************************************************************
+ * compute_batch
+ *
+ * Branch-free column loops over the whole batch, so the compiler can keep
+ * several frames per vector register.
+ *****************************************************************************/
+static void compute_batch(klv_footprint_t *footprint) {
+  size_t n = footprint->count;
+
+  for (int k = 0; k < 4; k++) {
+    const int32_t *raw_lat = footprint->corner[2 * k];
+    const int32_t *raw_lon = footprint->corner[2 * k + 1];
+    double *lat = footprint->lat[k];
+    double *lon = footprint->lon[k];
+
+    for (size_t i = 0; i < n; i++) {
+      double offsets = (double)footprint->use_offsets[i]; /* 0 or 1, blended rather than branched on */
+      double center_lat = map_val((double)footprint->center[0][i], INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
+      double center_lon = map_val((double)footprint->center[1][i], INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
+      double full_lat = map_val((double)raw_lat[i], INT32_MIN + 1, INT32_MAX, -90.0, 90.0);
+      double full_lon = map_val((double)raw_lon[i], INT32_MIN + 1, INT32_MAX, -180.0, 180.0);
+      double offset_lat = map_val((double)raw_lat[i], INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
+      double offset_lon = map_val((double)raw_lon[i], INT16_MIN + 1, INT16_MAX, -0.075, 0.075);
+
+      lat[i] = offsets * (center_lat + offset_lat) + (1.0 - offsets) * full_lat;
+      lon[i] = offsets * (center_lon + offset_lon) + (1.0 - offsets) * full_lon;
+      lon[i] += 360.0 * (double)((lon[i] < -180.0) - (lon[i] > 180.0)); /* an offset past the antimeridian */
+    }
+  }
+}
+
+/*****************************************************************************
+ * ring_order
+ *
+ * Corner order of the frame's ring, counterclockwise as RFC 7946 asks for
+ * exterior rings: 1-2-3-4 or, when that winds clockwise, 1-4-3-2. lon must be
+ * unwrapped so that no edge jumps across the antimeridian.
+ *****************************************************************************/
+static void ring_order(const double lon[4], const double lat[4], int order[5]) {
+  double area = 0.0;
+
+  for (int k = 0; k < 4; k++) {
+    int next = (k + 1) % 4;
+    area += lon[k] * lat[next] - lon[next] * lat[k];
+  }
+
+  order[0] = order[4] = 0;
+  for (int k = 1; k < 4; k++)
+    order[k] = (area < 0.0) ? 4 - k : k;
+}
+
+static void ring_push(fp_ring_t *ring, double lon, double lat) {
+  ring->lon[ring->count] = lon;
+  ring->lat[ring->count] = lat;
+  ring->count++;
+}
+
+/*****************************************************************************
+ * clip_ring
+ *
+ * The part of the ordered corners on one side of longitude 180, shifted by
+ * shift degrees and closed.
+ *****************************************************************************/
+static void clip_ring(const double lon[4], const double lat[4], const int order[5], int east, double shift,
+                      fp_ring_t *ring) {
+  ring->count = 0;
+  for (int k = 0; k < 4; k++) {
+    int a = order[k];
+    int b = order[k + 1];
+    int a_in = east ? (lon[a] >= 180.0) : (lon[a] <= 180.0);
+    int b_in = east ? (lon[b] >= 180.0) : (lon[b] <= 180.0);
+
+    if (a_in)
+      ring_push(ring, lon[a] + shift, lat[a]);
+    if (a_in != b_in && lon[a] != 180.0 && lon[b] != 180.0) { /* a corner on the cut is kept as it is */
+      double t = (180.0 - lon[a]) / (lon[b] - lon[a]);
+      ring_push(ring, 180.0 + shift, lat[a] + t * (lat[b] - lat[a]));
+    }
+  }
+  ring_push(ring, ring->lon[0], ring->lat[0]);
+}
+
+/*****************************************************************************
+ * frame_rings
+ *
+ * The frame's polygon as one ring or, when it crosses the antimeridian, as
+ * two split along it (RFC 7946 section 3.1.9). Returns the number of rings.
+ *****************************************************************************/
+static int frame_rings(const klv_footprint_t *footprint, size_t i, fp_ring_t rings[2]) {
+  double lon[4];
+  double lat[4];
+  double west = 180.0;
+  double east = -180.0;
+  int order[5];
+
+  /* unwrap the corners relative to the first one, then move the cut, if any, to +180 */
+  for (int k = 0; k < 4; k++) {
+    double d = footprint->lon[k][i] - footprint->lon[0][i];
+    lon[k] = footprint->lon[k][i] + 360.0 * (double)((d < -180.0) - (d > 180.0));
+    lat[k] = footprint->lat[k][i];
+    west = (lon[k] < west) ? lon[k] : west;
+  }
+  for (int k = 0; k < 4; k++) {
+    lon[k] += (west < -180.0) ? 360.0 : 0.0;
+    east = (lon[k] > east) ? lon[k] : east;
+  }
+  west += (west < -180.0) ? 360.0 : 0.0;
+  ring_order(lon, lat, order);
+
+  if (east <= 180.0 || west >= 180.0) {
+    clip_ring(lon, lat, order, west >= 180.0, (west >= 180.0) ? -360.0 : 0.0, &rings[0]);
+    return 1;
+  }
+  clip_ring(lon, lat, order, 0, 0.0, &rings[0]);
+  clip_ring(lon, lat, order, 1, -360.0, &rings[1]);
+  return 2;
+}
+
+static void put_le(uint8_t *p, uint64_t v, int len) {
+  for (int i = 0; i < len; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_double(uint8_t *p, double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  put_le(p, bits, 8);
+}
+
+static size_t put_polygon(uint8_t *p, const fp_ring_t *ring) {
+  p[0] = 1;                                /* little-endian */
+  put_le(p + 1, 3, 4);                     /* Polygon */
+  put_le(p + 5, 1, 4);                     /* rings */
+  put_le(p + 9, (uint64_t)ring->count, 4); /* points */
+  for (int k = 0; k < ring->count; k++) {
+    put_double(p + 13 + 16 * k, ring->lon[k]);
+    put_double(p + 21 + 16 * k, ring->lat[k]);
+  }
+  return 13 + 16 * (size_t)ring->count;
+}
+
+static void print_ring(FILE *out, const fp_ring_t *ring) {
+  fputs("[[", out);
+  for (int k = 0; k < ring->count; k++)
+    fprintf(out, "%s[%.9f, %.9f]", (k > 0) ? ", " : "", ring->lon[k], ring->lat[k]);
+  fputs("]]", out);
+}
+
+/*****************************************************************************
+ * libklv_footprint_flush
+ *
+ * Compute and write the polygons of the frames gathered so far.
+ *****************************************************************************/
+int libklv_footprint_flush(klv_footprint_t *footprint, FILE *out, uint8_t format) {
+  fp_ring_t rings[2];
+
+  if (footprint->count == 0)
+    return 0;
+  compute_batch(footprint);
+
+  for (size_t i = 0; i < footprint->count; i++) {
+    int num_rings = frame_rings(footprint, i, rings);
+
+    if (format == LIBKLV_OUTPUT_WKB) {
+      uint8_t wkb[9 + 2 * (13 + 16 * FP_RING_POINTS)];
+      size_t len = 0;
+      if (num_rings > 1) {
+        wkb[0] = 1;            /* little-endian */
+        put_le(wkb + 1, 6, 4); /* MultiPolygon */
+        put_le(wkb + 5, (uint64_t)num_rings, 4);
+        len = 9;
+      }
+      for (int r = 0; r < num_rings; r++)
+        len += put_polygon(wkb + len, &rings[r]);
+      fwrite(wkb, 1, len, out);
+    } else {
+      fputs("{\"type\": \"Feature\", \"properties\": {", out);
+      if (footprint->has_time[i])
+        fprintf(out, "\"time\": %" PRIu64, footprint->time[i]);
+      if (num_rings == 1) {
+        fputs("}, \"geometry\": {\"type\": \"Polygon\", \"coordinates\": ", out);
+        print_ring(out, &rings[0]);
+      } else {
+        fputs("}, \"geometry\": {\"type\": \"MultiPolygon\", \"coordinates\": [", out);
+        for (int r = 0; r < num_rings; r++) {
+          fputs((r > 0) ? ", " : "", out);
+          print_ring(out, &rings[r]);
+        }
+        fputc(']', out);
+      }
+      fputs("}}\n", out);
+    }
+  }
+
+  footprint->count = 0;
+  return ferror(out) ? -1 : 0;
+}
+
+/*****************************************************************************
+ * libklv_footprint_cleanup
+ *****************************************************************************/
+void libklv_footprint_cleanup(klv_footprint_t *footprint) {
+  free(footprint);
+}
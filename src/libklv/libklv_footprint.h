@@ -0,0 +1,40 @@
+#ifndef LIBKLV_FOOTPRINT_H_INCLUDED
+#define LIBKLV_FOOTPRINT_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "list.h"
+
+#define LIBKLV_FOOTPRINT_BATCH 1024 /* frames gathered before their polygons are computed together */
+#define LIBKLV_WKB_POLYGON_SIZE 93  /* one ring of five points */
+
+/*
+ * Ground footprint of each frame, from the four full corners (0x52-0x59) or,
+ * failing that, from the frame center (0x17/0x18) plus the four corner
+ * offsets (0x1A-0x21). Packets lacking either, or with an out-of-range
+ * value, have no footprint and are not written.
+ *
+ * Raw integers are gathered per packet into columns and converted in batches
+ * of LIBKLV_FOOTPRINT_BATCH with the decoder's mapping. The ring is closed and
+ * wound counterclockwise, corners in (longitude, latitude) order, longitudes
+ * within [-180, 180]. A footprint crossing the antimeridian is split along it
+ * into a MultiPolygon of two rings:
+ *
+ *   LIBKLV_OUTPUT_GEOJSON: one GeoJSON Feature per line, with the precision
+ *     time stamp (0x02) as property "time" when present
+ *   LIBKLV_OUTPUT_WKB: back-to-back little-endian WKB Polygons, of
+ *     LIBKLV_WKB_POLYGON_SIZE bytes unless split
+ */
+typedef struct klv_footprint_s klv_footprint_t;
+
+/*
+ * Global prototypes
+ */
+klv_footprint_t *libklv_footprint_init(void);
+int libklv_footprint_add(klv_footprint_t *footprint, FILE *out, uint8_t format, const struct list_head *first,
+                         const struct list_head *end);
+int libklv_footprint_flush(klv_footprint_t *footprint, FILE *out, uint8_t format);
+void libklv_footprint_cleanup(klv_footprint_t *footprint);
+
+#endif // LIBKLV_FOOTPRINT_H_INCLUDED
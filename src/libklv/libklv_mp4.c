@@ -0,0 +1,408 @@
+#include "libklv_mp4.h"
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+
+typedef struct mp4_sample_s {
+  uint64_t offset; /* from the start of the file */
+  uint32_t size;
+  int64_t pts;     /* microseconds */
+  int64_t max_pts; /* latest pts of this and every earlier sample, nondecreasing for seeking */
+} mp4_sample_t;
+
+struct klv_mp4_reader_s {
+  const uint8_t *data;
+  size_t size;
+  mp4_sample_t *samples;
+  size_t num_samples;
+  size_t next; /* sample returned by the next read */
+};
+
+/* sample tables of one track; len is 0 for a table that is missing */
+typedef struct mp4_table_s {
+  const uint8_t *body;
+  size_t len;
+} mp4_table_t;
+
+static inline uint32_t be32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline uint64_t be64(const uint8_t *p) {
+  return (uint64_t)be32(p) << 32 | be32(p + 4);
+}
+
+/*****************************************************************************
+ * next_box
+ *
+ * Step over the box at *p, which must lie within end. Returns false at the
+ * end of the parent or on a malformed box.
+ *****************************************************************************/
+static bool next_box(const uint8_t **p, const uint8_t *end, uint32_t *type, mp4_table_t *box) {
+  const uint8_t *q = *p;
+  size_t header = 8;
+
+  if (end - q < 8)
+    return false;
+  uint64_t size = be32(q);
+  *type = be32(q + 4);
+  if (size == 1) { /* 64-bit size */
+    if (end - q < 16)
+      return false;
+    size = be64(q + 8);
+    header = 16;
+  } else if (size == 0) { /* up to the end of the parent */
+    size = (uint64_t)(end - q);
+  }
+  if (size < header || size > (uint64_t)(end - q))
+    return false;
+
+  box->body = q + header;
+  box->len = (size_t)size - header;
+  *p = q + size;
+  return true;
+}
+
+/*****************************************************************************
+ * find_box
+ *
+ * First child of parent with the given type. box is left unchanged if there
+ * is none.
+ *****************************************************************************/
+static bool find_box(const mp4_table_t *parent, uint32_t type, mp4_table_t *box) {
+  const uint8_t *p = parent->body;
+  const uint8_t *end = parent->body + parent->len;
+  mp4_table_t child;
+  uint32_t t;
+
+  while (next_box(&p, end, &t, &child)) {
+    if (t == type) {
+      *box = child;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*****************************************************************************
+ * table_entries
+ *
+ * Entry count of a full box table whose entries follow the count at skip
+ * bytes into the body, checked against the box length.
+ *****************************************************************************/
+static bool table_entries(const mp4_table_t *table, size_t skip, size_t entry_size, uint32_t *count) {
+  if (table->len < skip + 4)
+    return false;
+  *count = be32(table->body + skip);
+  return (uint64_t)*count * entry_size <= table->len - skip - 4;
+}
+
+/*****************************************************************************
+ * media_to_us
+ *****************************************************************************/
+static inline int64_t media_to_us(int64_t t, uint32_t timescale) {
+  return (t / timescale) * 1000000 + (t % timescale) * 1000000 / timescale;
+}
+
+/*****************************************************************************
+ * chunk_samples
+ *
+ * Samples the chunks of stsc and stco/co64 hold, counted until limit is
+ * reached, so that a sample count can be checked before it is allocated.
+ *****************************************************************************/
+static uint64_t chunk_samples(const mp4_table_t *stsc, const mp4_table_t *stco, const mp4_table_t *co64, uint64_t limit) {
+  uint32_t runs, chunks;
+  bool wide = (stco->len == 0);
+  uint64_t total = 0;
+
+  if (!table_entries(stsc, 4, 12, &runs) || !table_entries(wide ? co64 : stco, 4, wide ? 8 : 4, &chunks))
+    return 0;
+  for (uint32_t r = 0; r < runs && total < limit; r++) {
+    const uint8_t *run = stsc->body + 8 + 12 * (size_t)r;
+    uint32_t first = be32(run);
+    uint32_t last = (r + 1 < runs) ? be32(run + 12) : chunks + 1; /* exclusive, 1-based */
+    if (first == 0 || last < first || last > chunks + 1)
+      return 0;
+    total += (uint64_t)(last - first) * be32(run + 4);
+  }
+  return total;
+}
+
+/*****************************************************************************
+ * sample_sizes
+ *
+ * Sizes of the samples, failing for more samples than max_count, the number
+ * the chunk tables can address.
+ *****************************************************************************/
+static bool sample_sizes(const mp4_table_t *stsz, const mp4_table_t *stz2, uint64_t max_count, mp4_sample_t **samples,
+                         size_t *count) {
+  uint32_t n, fixed = 0, field = 32;
+  const uint8_t *entries;
+
+  if (stsz->len > 0) {
+    if (stsz->len < 12)
+      return false;
+    fixed = be32(stsz->body + 4);
+    n = be32(stsz->body + 8);
+    if (fixed == 0 && (uint64_t)n * 4 > stsz->len - 12)
+      return false;
+    entries = stsz->body + 12;
+  } else if (stz2->len >= 12) {
+    field = stz2->body[7];
+    n = be32(stz2->body + 8);
+    if ((field != 4 && field != 8 && field != 16) || ((uint64_t)n * field + 7) / 8 > stz2->len - 12)
+      return false;
+    entries = stz2->body + 12;
+  } else {
+    return false;
+  }
+  if (n > max_count)
+    return false; /* a count the tables cannot back, e.g. of fixed-size samples */
+
+  *samples = (mp4_sample_t *)calloc((n > 0) ? n : 1, sizeof(mp4_sample_t));
+  if (*samples == NULL)
+    return false;
+  for (uint32_t i = 0; i < n; i++) {
+    if (fixed != 0)
+      (*samples)[i].size = fixed;
+    else if (field == 32)
+      (*samples)[i].size = be32(entries + 4 * (size_t)i);
+    else if (field == 16)
+      (*samples)[i].size = (uint32_t)entries[2 * (size_t)i] << 8 | entries[2 * (size_t)i + 1];
+    else if (field == 8)
+      (*samples)[i].size = entries[i];
+    else
+      (*samples)[i].size = (entries[i / 2] >> ((i & 1) ? 0 : 4)) & 0x0F;
+  }
+  *count = n;
+  return true;
+}
+
+/*****************************************************************************
+ * sample_offsets
+ *
+ * Walk the chunks: stsc gives the samples in each run of chunks, stco/co64
+ * the file offset of each chunk, and samples follow each other in a chunk.
+ *****************************************************************************/
+static bool sample_offsets(const mp4_table_t *stsc, const mp4_table_t *stco, const mp4_table_t *co64, mp4_sample_t *samples,
+                           size_t count, size_t file_size) {
+  uint32_t runs, chunks;
+  bool wide = (stco->len == 0);
+  const mp4_table_t *offsets = wide ? co64 : stco;
+  size_t s = 0;
+
+  if (!table_entries(stsc, 4, 12, &runs) || !table_entries(offsets, 4, wide ? 8 : 4, &chunks))
+    return false;
+
+  for (uint32_t r = 0; r < runs && s < count; r++) {
+    const uint8_t *run = stsc->body + 8 + 12 * (size_t)r;
+    uint32_t first = be32(run);
+    uint32_t last = (r + 1 < runs) ? be32(run + 12) : chunks + 1; /* exclusive, 1-based */
+    uint32_t per_chunk = be32(run + 4);
+    if (first == 0 || last < first || last > chunks + 1)
+      return false;
+
+    for (uint32_t c = first; c < last && s < count; c++) {
+      const uint8_t *entry = offsets->body + 8 + (size_t)(c - 1) * (wide ? 8 : 4);
+      uint64_t offset = wide ? be64(entry) : be32(entry);
+      for (uint32_t k = 0; k < per_chunk && s < count; k++, s++) {
+        if (offset > file_size || samples[s].size > file_size - offset)
+          return false;
+        samples[s].offset = offset;
+        offset += samples[s].size;
+      }
+    }
+  }
+  return s == count;
+}
+
+/*****************************************************************************
+ * sample_times
+ *
+ * Decoding times from stts plus composition offsets from ctts, if present.
+ * Samples beyond the tables keep the last time. With ctts, presentation
+ * times need not rise in decoding order, so their running maximum is kept
+ * for seeking.
+ *****************************************************************************/
+static bool sample_times(const mp4_table_t *stts, const mp4_table_t *ctts, uint32_t timescale, mp4_sample_t *samples,
+                         size_t count) {
+  uint32_t runs;
+  int64_t dts = 0;
+  size_t s = 0;
+
+  if (!table_entries(stts, 4, 8, &runs))
+    return false;
+  for (uint32_t r = 0; r < runs && s < count; r++) {
+    uint32_t n = be32(stts->body + 8 + 8 * (size_t)r);
+    uint32_t delta = be32(stts->body + 12 + 8 * (size_t)r);
+    for (uint32_t k = 0; k < n && s < count; k++, s++) {
+      samples[s].pts = dts;
+      dts += delta;
+    }
+  }
+  for (; s < count; s++)
+    samples[s].pts = dts;
+
+  if (ctts->len > 0) {
+    bool is_signed = (ctts->body[0] == 1);
+    if (!table_entries(ctts, 4, 8, &runs))
+      return false;
+    s = 0;
+    for (uint32_t r = 0; r < runs && s < count; r++) {
+      uint32_t n = be32(ctts->body + 8 + 8 * (size_t)r);
+      uint32_t raw = be32(ctts->body + 12 + 8 * (size_t)r);
+      int64_t offset = is_signed ? (int64_t)(int32_t)raw : (int64_t)raw;
+      for (uint32_t k = 0; k < n && s < count; k++, s++)
+        samples[s].pts += offset;
+    }
+  }
+
+  for (s = 0; s < count; s++) {
+    samples[s].pts = media_to_us(samples[s].pts, timescale);
+    samples[s].max_pts = (s > 0 && samples[s - 1].max_pts > samples[s].pts) ? samples[s - 1].max_pts : samples[s].pts;
+  }
+  return true;
+}
+
+/*****************************************************************************
+ * read_track
+ *
+ * Flatten the sample tables of trak if it is a KLV track.
+ *****************************************************************************/
+static bool read_track(klv_mp4_reader_t *reader, const mp4_table_t *trak) {
+  mp4_table_t mdia, hdlr, mdhd, minf, stbl;
+  mp4_table_t stsz = {0}, stz2 = {0}, stsc = {0}, stco = {0}, co64 = {0}, stts = {0}, ctts = {0};
+  static const uint8_t universal_label[4] = {0x06, 0x0E, 0x2B, 0x34};
+
+  if (!find_box(trak, FOURCC('m', 'd', 'i', 'a'), &mdia) || !find_box(&mdia, FOURCC('h', 'd', 'l', 'r'), &hdlr) ||
+      hdlr.len < 12 || !find_box(&mdia, FOURCC('m', 'd', 'h', 'd'), &mdhd) || mdhd.len < 24 ||
+      !find_box(&mdia, FOURCC('m', 'i', 'n', 'f'), &minf) || !find_box(&minf, FOURCC('s', 't', 'b', 'l'), &stbl))
+    return false;
+
+  uint32_t handler = be32(hdlr.body + 8);
+  if (handler == FOURCC('v', 'i', 'd', 'e') || handler == FOURCC('s', 'o', 'u', 'n'))
+    return false;
+  uint32_t timescale = be32(mdhd.body + ((mdhd.body[0] == 1) ? 20 : 12));
+  if (timescale == 0 || (mdhd.body[0] == 1 && mdhd.len < 32))
+    return false;
+
+  find_box(&stbl, FOURCC('s', 't', 's', 'z'), &stsz);
+  find_box(&stbl, FOURCC('s', 't', 'z', '2'), &stz2);
+  find_box(&stbl, FOURCC('s', 't', 's', 'c'), &stsc);
+  find_box(&stbl, FOURCC('s', 't', 'c', 'o'), &stco);
+  find_box(&stbl, FOURCC('c', 'o', '6', '4'), &co64);
+  find_box(&stbl, FOURCC('s', 't', 't', 's'), &stts);
+  find_box(&stbl, FOURCC('c', 't', 't', 's'), &ctts);
+
+  mp4_sample_t *samples = NULL;
+  size_t count = 0;
+  uint64_t max_count = chunk_samples(&stsc, &stco, &co64, UINT32_MAX);
+  if (!sample_sizes(&stsz, &stz2, max_count, &samples, &count) || count == 0 ||
+      !sample_offsets(&stsc, &stco, &co64, samples, count, reader->size) ||
+      !sample_times(&stts, &ctts, timescale, samples, count) || samples[0].size < sizeof(universal_label) ||
+      memcmp(reader->data + samples[0].offset, universal_label, sizeof(universal_label)) != 0) {
+    free(samples);
+    return false;
+  }
+
+  reader->samples = samples;
+  reader->num_samples = count;
+  return true;
+}
+
+/*****************************************************************************
+ * libklv_is_mp4
+ *
+ * Whether data starts like an ISO-BMFF file, with an ftyp box.
+ *****************************************************************************/
+bool libklv_is_mp4(const uint8_t *data, size_t size) {
+  return size >= 12 && be32(data + 4) == FOURCC('f', 't', 'y', 'p') && be32(data) >= 8;
+}
+
+/*****************************************************************************
+ * libklv_mp4_reader_init
+ *
+ * Find the KLV track of an MP4 file in a caller-owned buffer, e.g. a mapped
+ * file. The caller must keep data alive and unchanged while the reader and
+ * any items read from it are in use. Returns NULL if there is no KLV track.
+ *****************************************************************************/
+klv_mp4_reader_t *libklv_mp4_reader_init(const uint8_t *data, size_t size) {
+  mp4_table_t file = {.body = data, .len = size};
+  mp4_table_t moov, trak;
+  const uint8_t *p;
+  uint32_t type;
+
+  if (!find_box(&file, FOURCC('m', 'o', 'o', 'v'), &moov))
+    return NULL;
+  klv_mp4_reader_t *reader = (klv_mp4_reader_t *)calloc(1, sizeof(klv_mp4_reader_t));
+  if (reader == NULL)
+    return NULL;
+  reader->data = data;
+  reader->size = size;
+
+  for (p = moov.body; next_box(&p, moov.body + moov.len, &type, &trak);) {
+    if (type == FOURCC('t', 'r', 'a', 'k') && read_track(reader, &trak))
+      return reader;
+  }
+  free(reader);
+  return NULL;
+}
+
+/*****************************************************************************
+ * libklv_mp4_num_samples
+ *****************************************************************************/
+size_t libklv_mp4_num_samples(const klv_mp4_reader_t *reader) {
+  return reader->num_samples;
+}
+
+/*****************************************************************************
+ * libklv_mp4_read_sample
+ *
+ * Parse the next sample into ctx, in place, writing its packets through the
+ * context's writer. pts, if not NULL, receives its presentation time.
+ * Returns 1 after a sample, 0 at the end of the track and -1 on error.
+ *****************************************************************************/
+int libklv_mp4_read_sample(klv_mp4_reader_t *reader, klv_ctx_t *ctx, int64_t *pts) {
+  if (reader->next == reader->num_samples)
+    return 0;
+
+  const mp4_sample_t *sample = &reader->samples[reader->next++];
+  if (pts != NULL)
+    *pts = sample->pts;
+  libklv_borrow_ctx_buffer(ctx, (void *)(uintptr_t)(reader->data + sample->offset), sample->size);
+  return (libklv_parse_data(ctx) < 0) ? -1 : 1;
+}
+
+/*****************************************************************************
+ * libklv_mp4_seek
+ *
+ * Continue reading from the first sample, in decoding order, presented at or
+ * after pts. That is the first whose running maximum presentation time
+ * reaches pts, found by binary search even when ctts reorders samples.
+ * Returns -1, leaving the position unchanged, if there is none.
+ *****************************************************************************/
+int libklv_mp4_seek(klv_mp4_reader_t *reader, int64_t pts) {
+  size_t lo = 0;
+  size_t hi = reader->num_samples;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (reader->samples[mid].max_pts < pts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == reader->num_samples)
+    return -1;
+  reader->next = lo;
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_mp4_reader_cleanup
+ *****************************************************************************/
+void libklv_mp4_reader_cleanup(klv_mp4_reader_t *reader) {
+  if (reader == NULL)
+    return;
+  free(reader->samples);
+  free(reader);
+}
@@ -0,0 +1,35 @@
+#ifndef LIBKLV_MP4_H_INCLUDED
+#define LIBKLV_MP4_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libklv.h"
+
+/*
+ * Reads the KLV timed-metadata track of an MP4 (ISO-BMFF) file straight out
+ * of the file's bytes, e.g. a mapped file, without demuxing it first.
+ *
+ * The moov box is walked for the first track that is neither video nor
+ * audio and whose first sample starts with a SMPTE universal label. Its
+ * sample tables (stsz/stz2, stsc, stco/co64, stts and ctts) are flattened
+ * into one offset, size and presentation time per sample. Each sample is then
+ * parsed in place by libklv. Presentation times are in microseconds from the
+ * start of the track's media timeline; edit lists are not applied.
+ *
+ * Fragmented files (moof boxes) are not supported.
+ */
+typedef struct klv_mp4_reader_s klv_mp4_reader_t;
+
+/*
+ * Global prototypes
+ */
+bool libklv_is_mp4(const uint8_t *data, size_t size);
+klv_mp4_reader_t *libklv_mp4_reader_init(const uint8_t *data, size_t size);
+size_t libklv_mp4_num_samples(const klv_mp4_reader_t *reader);
+int libklv_mp4_read_sample(klv_mp4_reader_t *reader, klv_ctx_t *ctx, int64_t *pts);
+int libklv_mp4_seek(klv_mp4_reader_t *reader, int64_t pts);
+void libklv_mp4_reader_cleanup(klv_mp4_reader_t *reader);
+
+#endif // LIBKLV_MP4_H_INCLUDED
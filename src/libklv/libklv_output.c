@@ -0,0 +1,611 @@
+#include "libklv_output.h"
+#include "libklv.h"
+#include "libklv_aggregate.h"
+#include "libklv_archive.h"
+#include "libklv_footprint.h"
+#include "libklv_publish.h"
+#include "libklv_tags.h"
+#include <float.h>
+#include <inttypes.h>
+
+/* JSON label and number of decimals used for each tag's mapped value */
+typedef struct json_field_s {
+  const char *label;
+  uint8_t precision;
+} json_field_t;
+
+static const json_field_t json_fields[256] = {
+    [0x01] = {"checksum", 0},
+    [0x02] = {"unix epoch", 0},
+    [0x03] = {"mission id", 0},
+    [0x04] = {"tail number", 0},
+    [0x05] = {"platform heading ang", 15},
+    [0x06] = {"platform pitch angle", 12},
+    [0x07] = {"platform roll angle", 12},
+    [0x08] = {"platform true airspeed", 0},
+    [0x09] = {"platform indicated speed", 0},
+    [0x0A] = {"platform designation", 0},
+    [0x0B] = {"image source sensor", 0},
+    [0x0C] = {"coordinate system", 0},
+    [0x0D] = {"sensor latitude", 14},
+    [0x0E] = {"sensor longitude", 14},
+    [0x0F] = {"sensor true altitude", 12},
+    [0x10] = {"sensor horizontal FOV", 15},
+    [0x11] = {"sensor vertical FOV", 15},
+    [0x12] = {"sensor rel az ang", 14},
+    [0x13] = {"sensor rel elev ang", 14},
+    [0x14] = {"sensor rel roll ang", 14},
+    [0x15] = {"slant range", 14},
+    [0x16] = {"target width", 14},
+    [0x17] = {"frame center lat", 14},
+    [0x18] = {"frame center lon", 14},
+    [0x19] = {"frame center elev", 12},
+    [0x1A] = {"offset crnr lat 1", 12},
+    [0x1B] = {"offset crnr lon 1", 12},
+    [0x1C] = {"offset crnr lat 2", 12},
+    [0x1D] = {"offset crnr lon 2", 12},
+    [0x1E] = {"offset crnr lat 3", 12},
+    [0x1F] = {"offset crnr lon 3", 12},
+    [0x20] = {"offset crnr lat 4", 12},
+    [0x21] = {"offset crnr lon 4", 12},
+    [0x22] = {"icing detected", 0},
+    [0x23] = {"wind direction", 12},
+    [0x24] = {"wind speed", 12},
+    [0x25] = {"static pressure (mbar)", 12},
+    [0x26] = {"density altitude", 12},
+    [0x27] = {"outside air temp", 0},
+    [0x28] = {"target location lat", 14},
+    [0x29] = {"target location lon", 14},
+    [0x2A] = {"target location elev", 14},
+    [0x2B] = {"target track gate wdth", 14},
+    [0x2C] = {"target track gate ht.", 14},
+    [0x2D] = {"target err est. CE90", 14},
+    [0x2E] = {"target err est. LE90", 14},
+    [0x2F] = {"generic flag data 01", 0},
+    [0x30] = {"sec local metadata set", 0},
+    [0x31] = {"differential pressure", 14},
+    [0x32] = {"platform angle of atk", 12},
+    [0x33] = {"platform vert speed", 12},
+    [0x34] = {"platform slideslip ang", 12},
+    [0x35] = {"airfield pressure", 12},
+    [0x36] = {"airfield elev", 12},
+    [0x37] = {"relative humidity", 12},
+    [0x38] = {"platform gnd speed", 0},
+    [0x39] = {"ground range", 14},
+    [0x3A] = {"platform fuel remain", 14},
+    [0x3B] = {"platform call sign", 0},
+    [0x3C] = {"weapon load", 0},
+    [0x3D] = {"weapon fired", 0},
+    [0x3E] = {"laser prf code", 0},
+    [0x3F] = {"sensor fov name", 0},
+    [0x40] = {"platform mag head ang", 12},
+    [0x41] = {"uas ls version num", 0},
+    [0x43] = {"alt platfm latitude", 14},
+    [0x44] = {"alt platfm longitude", 14},
+    [0x45] = {"alt altitude", 12},
+    [0x46] = {"alt pltfrm name", 0},
+    [0x47] = {"alternate platform heading", 15},
+    [0x48] = {"event start time", 0},
+    [0x49] = {"rvt local set", 0},
+    [0x4A] = {"vmti data set", 0},
+    [0x4B] = {"sensor ellip ht.", 15},
+    [0x4C] = {"alt pltfm elpsd ht.", 15},
+    [0x4D] = {"operational mode", 0},
+    [0x4E] = {"frame center height above ellipsoid ", 14},
+    [0x4F] = {"sensor north velocity", 14},
+    [0x50] = {"sensor east velocity", 14},
+    [0x52] = {"corner latitude point 1 (full)", 14},
+    [0x53] = {"corner longitude point 1 (full)", 14},
+    [0x54] = {"corner latitude point 2 (full)", 14},
+    [0x55] = {"corner longitude point 2 (full)", 14},
+    [0x56] = {"corner latitude point 3 (full)", 14},
+    [0x57] = {"corner longitude point 3 (full)", 14},
+    [0x58] = {"corner latitude point 4 (full)", 14},
+    [0x59] = {"corner longitude point 4 (full)", 14},
+    [0x5A] = {"platform pitch angle (full)", 14},
+    [0x5B] = {"platform roll angle (full)", 14},
+    [0x5C] = {"platform angle of attack (full)", 14},
+    [0x5D] = {"platform sideslip angle (full)", 14},
+};
+
+/*
+ * Binary formats are assembled in a small staging buffer and handed to stdio
+ * in large pieces rather than one fwrite per field.
+ */
+typedef struct out_buf_s {
+  FILE *out;
+  size_t len;
+  uint8_t data[2048];
+} out_buf_t;
+
+/*****************************************************************************
+ * out_flush
+ *****************************************************************************/
+static void out_flush(out_buf_t *b) {
+  if (b->len > 0)
+    fwrite(b->data, 1, b->len, b->out);
+  b->len = 0;
+}
+
+/*****************************************************************************
+ * out_put
+ *****************************************************************************/
+static void out_put(out_buf_t *b, const void *src, size_t len) {
+  if (b->len + len > sizeof(b->data)) {
+    out_flush(b);
+    if (len > sizeof(b->data)) {
+      fwrite(src, 1, len, b->out);
+      return;
+    }
+  }
+  memcpy(b->data + b->len, src, len);
+  b->len += len;
+}
+
+/*****************************************************************************
+ * out_be
+ *
+ * Write a lead byte followed by the len low-order bytes of value, big-endian.
+ *****************************************************************************/
+static void out_be(out_buf_t *b, uint8_t lead, uint64_t value, int len) {
+  uint8_t tmp[9];
+  tmp[0] = lead;
+  for (int i = 0; i < len; i++)
+    tmp[1 + i] = (uint8_t)(value >> (8 * (len - 1 - i)));
+  out_put(b, tmp, (size_t)len + 1);
+}
+
+/*****************************************************************************
+ * double_bits
+ *****************************************************************************/
+static inline uint64_t double_bits(double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  return bits;
+}
+
+/*****************************************************************************
+ * item_value_type
+ *
+ * Classify an item for the typed output formats. Returns -1 for items that
+ * carry nothing to write (unknown tags, tags the decoder skips over).
+ *****************************************************************************/
+static int item_value_type(const klv_item_t *item) {
+  const klv_tag_desc_t *desc = libklv_tag_desc(item->id);
+  if (desc == NULL)
+    return -1;
+
+  switch (desc->type) {
+  case KLV_TYPE_STRING:
+    return (item->data != NULL) ? KLV_VALUE_STRING : -1;
+  case KLV_TYPE_BYTES:
+    return (item->data != NULL) ? KLV_VALUE_BYTES : -1;
+  case KLV_TYPE_UINT:
+  case KLV_TYPE_INT:
+    if (desc->min < desc->max) /* DBL_MIN flags an out-of-range value */
+      return (item->mapped_val != DBL_MIN) ? KLV_VALUE_DOUBLE : KLV_VALUE_NONE;
+    return (desc->type == KLV_TYPE_INT) ? KLV_VALUE_INT : KLV_VALUE_UINT;
+  default:
+    return -1;
+  }
+}
+
+/*****************************************************************************
+ * count_items
+ *****************************************************************************/
+static size_t count_items(const struct list_head *first, const struct list_head *end, size_t *data_size) {
+  const struct list_head *pos;
+  size_t count = 0;
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    int type = item_value_type(item);
+    if (type < 0)
+      continue;
+    count++;
+    if (data_size != NULL && type == KLV_VALUE_STRING)
+      *data_size += item->len + 1;
+    else if (data_size != NULL && type == KLV_VALUE_BYTES)
+      *data_size += item->len;
+  }
+
+  return count;
+}
+
+/*****************************************************************************
+ * write_json_item
+ *****************************************************************************/
+static void write_json_item(klv_writer_t *writer, const klv_item_t *item) {
+  FILE *out = writer->out;
+  const json_field_t *field = &json_fields[item->id];
+  uint8_t stn_num;
+  uint8_t substn_num;
+  uint8_t wpn_type;
+  uint8_t wpn_var;
+
+  if (field->label == NULL)
+    return;
+
+  switch (item->id) {
+  case 0x01: /* checksum closes the packet, so no separator */
+    fprintf(out, "\"%d\": [\"%s\", \"%" PRIu64 "\"]", item->id, field->label, item->value);
+    return;
+  case 0x02:
+    fprintf(out, "\"%d\": [\"%s\", \"%s\"], ", item->id, field->label, libklv_format_time(&writer->time_fmt, item->value));
+    return;
+  case 0x2F:
+    fprintf(out, "\"%d\": [\"%s\", {\"Laser Range\": \"%" PRIu64 "\",", item->id, field->label, (item->value & 0x01));
+    fprintf(out, "\"Auto_Track\": \"%" PRIu64 "\",", (item->value & 0x02));
+    fprintf(out, "\"IR_Polarity\": \"%" PRIu64 "\",", (item->value & 0x04));
+    fprintf(out, "\"Icing_detected\": \"%" PRIu64 "\",", (item->value & 0x08));
+    fprintf(out, "\"Slant_Range\": \"%" PRIu64 "\",", (item->value & 0x10));
+    fprintf(out, "\"Image_Invalid\": \"%" PRIu64 "\"", (item->value & 0x20));
+    fprintf(out, "}], ");
+    return;
+  case 0x30:
+    fprintf(out, "\"%d\": [\"%s\", \"set size=%d\"], ", item->id, field->label, item->len);
+    return;
+  case 0x3C:
+    // TODO: figure out weapon variants and type names
+    /*       byte 1           byte 2
+     * +--------+--------+--------+--------+
+     * |  nib1  |  nib2  |  nib1  |  nib2  |
+     * +--------+--------+--------+--------+
+     * 32                16                1
+     *
+     * byte1 - nib1 = Station number
+     * byte1 - nib2 = Substation Number
+     * byte2 - nib1 = Weapon type
+     * byte2 - nib2 = Weapon variant
+     */
+    stn_num = (uint8_t)((item->value >> 8) - (item->value >> 12));
+    substn_num = (uint8_t)(item->value >> 8) - ((item->value >> 8) & 0x0F);
+    wpn_type = (item->value & 0x00FF) - ((item->value >> 4) & 0x0F);
+    wpn_var = (item->value & 0x00FF) - (item->value & 0x000F);
+    fprintf(out, "\"%d\": [\"%s\", \"%d|%d|%d|%d\"], ", item->id, field->label, stn_num, substn_num, wpn_type, wpn_var);
+    return;
+  case 0x3D:
+    /* +--------+--------+
+     * |  STN # |SUBSTN #|
+     * +--------+--------+
+     * 8                 1
+     */
+    stn_num = (uint8_t)((item->value) - ((item->value >> 4) & 0x0F));
+    substn_num = (uint8_t)((item->value) - (item->value & 0x0F));
+    fprintf(out, "\"%d\": [\"%s\", \"%d|%d\"], ", item->id, field->label, stn_num, substn_num);
+    return;
+  case 0x41:
+    fprintf(out, "\"%d\": [\"%s\", \"ST0601.%" PRIu64 "\"], ", item->id, field->label, item->value);
+    return;
+  case 0x49:
+    if (item->data != NULL)
+      fprintf(out, "\"%d\": [\"%s\", \"%.*s\"], ", item->id, field->label, item->len, (const char *)item->data);
+    return;
+  case 0x4A:
+    if (item->data != NULL) {
+      const uint8_t *cp = (const uint8_t *)item->data;
+      fprintf(out, "\"%d\": [\"%s\", \"", item->id, field->label);
+      for (uint8_t i = 0; i < item->len; i++) {
+        fprintf(out, "\\\\x%02x", cp[i]);
+      }
+      fprintf(out, "\"], ");
+    }
+    return;
+  }
+
+  if (item->data != NULL) { /* strings, and enumerations decoded to their names */
+    fprintf(out, "\"%d\": [\"%s\", \"%s\"], ", item->id, field->label, (const char *)item->data);
+    return;
+  }
+
+  switch (item_value_type(item)) {
+  case KLV_VALUE_DOUBLE:
+  case KLV_VALUE_NONE:
+    fprintf(out, "\"%d\": [\"%s\", \"%.*f\"], ", item->id, field->label, field->precision, item->mapped_val);
+    break;
+  case KLV_VALUE_UINT:
+    fprintf(out, "\"%d\": [\"%s\", \"%" PRIu64 "\"], ", item->id, field->label, item->value);
+    break;
+  case KLV_VALUE_INT:
+    fprintf(out, "\"%d\": [\"%s\", \"%" PRId64 "\"], ", item->id, field->label, item->signed_val);
+    break;
+  }
+}
+
+/*****************************************************************************
+ * write_json
+ *****************************************************************************/
+static void write_json(klv_writer_t *writer, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+
+  fputc('{', writer->out);
+  for (pos = first; pos != end; pos = pos->next)
+    write_json_item(writer, list_entry(pos, klv_item_t, list));
+  fputs("}\n", writer->out);
+}
+
+/*****************************************************************************
+ * msgpack_uint
+ *****************************************************************************/
+static void msgpack_uint(out_buf_t *b, uint64_t v) {
+  if (v <= 0x7F)
+    out_be(b, (uint8_t)v, 0, 0);
+  else if (v <= UINT8_MAX)
+    out_be(b, 0xCC, v, 1);
+  else if (v <= UINT16_MAX)
+    out_be(b, 0xCD, v, 2);
+  else if (v <= UINT32_MAX)
+    out_be(b, 0xCE, v, 4);
+  else
+    out_be(b, 0xCF, v, 8);
+}
+
+/*****************************************************************************
+ * msgpack_int
+ *****************************************************************************/
+static void msgpack_int(out_buf_t *b, int64_t v) {
+  if (v >= 0)
+    msgpack_uint(b, (uint64_t)v);
+  else if (v >= -32)
+    out_be(b, (uint8_t)(int8_t)v, 0, 0); /* negative fixint */
+  else if (v >= INT8_MIN)
+    out_be(b, 0xD0, (uint64_t)v, 1);
+  else if (v >= INT16_MIN)
+    out_be(b, 0xD1, (uint64_t)v, 2);
+  else if (v >= INT32_MIN)
+    out_be(b, 0xD2, (uint64_t)v, 4);
+  else
+    out_be(b, 0xD3, (uint64_t)v, 8);
+}
+
+/*****************************************************************************
+ * write_msgpack
+ *****************************************************************************/
+static void write_msgpack(out_buf_t *b, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+  size_t count = count_items(first, end, NULL);
+
+  if (count <= 15)
+    out_be(b, (uint8_t)(0x80 | count), 0, 0); /* fixmap */
+  else
+    out_be(b, 0xDE, count, 2); /* map 16 */
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    int type = item_value_type(item);
+    if (type < 0)
+      continue;
+
+    msgpack_uint(b, item->id);
+    switch (type) {
+    case KLV_VALUE_NONE:
+      out_be(b, 0xC0, 0, 0); /* nil */
+      break;
+    case KLV_VALUE_UINT:
+      msgpack_uint(b, item->value);
+      break;
+    case KLV_VALUE_INT:
+      msgpack_int(b, item->signed_val);
+      break;
+    case KLV_VALUE_DOUBLE:
+      out_be(b, 0xCB, double_bits(item->mapped_val), 8);
+      break;
+    case KLV_VALUE_STRING:
+      if (item->len <= 31)
+        out_be(b, (uint8_t)(0xA0 | item->len), 0, 0); /* fixstr */
+      else
+        out_be(b, 0xD9, item->len, 1); /* str 8 */
+      out_put(b, item->data, item->len);
+      break;
+    case KLV_VALUE_BYTES:
+      out_be(b, 0xC4, item->len, 1); /* bin 8 */
+      out_put(b, item->data, item->len);
+      break;
+    }
+  }
+}
+
+/*****************************************************************************
+ * cbor_head
+ *****************************************************************************/
+static void cbor_head(out_buf_t *b, uint8_t major, uint64_t n) {
+  major = (uint8_t)(major << 5);
+  if (n < 24)
+    out_be(b, (uint8_t)(major | n), 0, 0);
+  else if (n <= UINT8_MAX)
+    out_be(b, major | 24, n, 1);
+  else if (n <= UINT16_MAX)
+    out_be(b, major | 25, n, 2);
+  else if (n <= UINT32_MAX)
+    out_be(b, major | 26, n, 4);
+  else
+    out_be(b, major | 27, n, 8);
+}
+
+/*****************************************************************************
+ * write_cbor
+ *****************************************************************************/
+static void write_cbor(out_buf_t *b, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+
+  cbor_head(b, 5, count_items(first, end, NULL)); /* map */
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    int type = item_value_type(item);
+    if (type < 0)
+      continue;
+
+    cbor_head(b, 0, item->id);
+    switch (type) {
+    case KLV_VALUE_NONE:
+      out_be(b, 0xF6, 0, 0); /* null */
+      break;
+    case KLV_VALUE_UINT:
+      cbor_head(b, 0, item->value);
+      break;
+    case KLV_VALUE_INT:
+      if (item->signed_val >= 0)
+        cbor_head(b, 0, (uint64_t)item->signed_val);
+      else
+        cbor_head(b, 1, ~(uint64_t)item->signed_val); /* -1 - n */
+      break;
+    case KLV_VALUE_DOUBLE:
+      out_be(b, 0xFB, double_bits(item->mapped_val), 8);
+      break;
+    case KLV_VALUE_STRING:
+      cbor_head(b, 3, item->len);
+      out_put(b, item->data, item->len);
+      break;
+    case KLV_VALUE_BYTES:
+      cbor_head(b, 2, item->len);
+      out_put(b, item->data, item->len);
+      break;
+    }
+  }
+}
+
+/*****************************************************************************
+ * write_record
+ *****************************************************************************/
+static void write_record(out_buf_t *b, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+  static const uint8_t padding[8] = {0};
+  size_t data_size = 0;
+  size_t count = count_items(first, end, &data_size);
+  size_t data_offset = sizeof(klv_record_t) + (count * sizeof(klv_record_entry_t));
+  size_t size = (data_offset + data_size + 7) & ~(size_t)7;
+
+  klv_record_t header = {.size = (uint32_t)size, .count = (uint16_t)count, .reserved = 0};
+  out_put(b, &header, sizeof(header));
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    int type = item_value_type(item);
+    if (type < 0)
+      continue;
+
+    klv_record_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.id = item->id;
+    entry.type = (uint8_t)type;
+    switch (type) {
+    case KLV_VALUE_UINT:
+      entry.value.u = item->value;
+      break;
+    case KLV_VALUE_INT:
+      entry.value.i = item->signed_val;
+      break;
+    case KLV_VALUE_DOUBLE:
+      entry.value.d = item->mapped_val;
+      break;
+    case KLV_VALUE_STRING:
+    case KLV_VALUE_BYTES:
+      entry.len = item->len;
+      entry.data_offset = (uint32_t)data_offset;
+      data_offset += item->len + (type == KLV_VALUE_STRING ? 1 : 0);
+      break;
+    }
+    out_put(b, &entry, sizeof(entry));
+  }
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    int type = item_value_type(item);
+    if (type == KLV_VALUE_STRING)
+      out_put(b, item->data, item->len + 1); /* keep the null-terminator */
+    else if (type == KLV_VALUE_BYTES)
+      out_put(b, item->data, item->len);
+  }
+
+  out_put(b, padding, size - data_offset);
+}
+
+/*****************************************************************************
+ * libklv_write_packet
+ *
+ * Serialize the decoded items of one packet, [first, end) within an item
+ * list, in the writer's format.
+ *****************************************************************************/
+int libklv_write_packet(klv_writer_t *writer, const struct list_head *first, const struct list_head *end) {
+  out_buf_t b;
+
+  if (writer->publish != NULL && libklv_publish_packet(writer->publish, first, end) < 0)
+    return -1;
+  if (writer->aggregate != NULL)
+    return libklv_aggregate_packet(writer->aggregate, writer->out, first, end);
+
+  b.out = writer->out;
+  b.len = 0;
+
+  switch (writer->format) {
+  case LIBKLV_OUTPUT_NONE:
+    return 0;
+  case LIBKLV_OUTPUT_JSON:
+    write_json(writer, first, end);
+    break;
+  case LIBKLV_OUTPUT_MSGPACK:
+    write_msgpack(&b, first, end);
+    break;
+  case LIBKLV_OUTPUT_CBOR:
+    write_cbor(&b, first, end);
+    break;
+  case LIBKLV_OUTPUT_RECORD:
+    write_record(&b, first, end);
+    break;
+  case LIBKLV_OUTPUT_ARCHIVE:
+    if (writer->archive == NULL && (writer->archive = libklv_archive_writer_init(writer->out)) == NULL)
+      return -1;
+    return libklv_archive_write_packet(writer->archive, first, end);
+  case LIBKLV_OUTPUT_GEOJSON:
+  case LIBKLV_OUTPUT_WKB:
+    if (writer->footprint == NULL && (writer->footprint = libklv_footprint_init()) == NULL)
+      return -1;
+    return libklv_footprint_add(writer->footprint, writer->out, writer->format, first, end);
+  default:
+    return -1;
+  }
+
+  out_flush(&b);
+  return ferror(writer->out) ? -1 : 0;
+}
+
+/*****************************************************************************
+ * libklv_writer_flush
+ *
+ * Write out the footprints gathered so far and flush the stream, for a
+ * writer that has caught up with a live source. Archive blocks and
+ * aggregation windows are still written only once they are complete, since
+ * cutting them short would cost compression or change the summary.
+ *****************************************************************************/
+int libklv_writer_flush(klv_writer_t *writer) {
+  int ret = 0;
+
+  if (writer->footprint != NULL && libklv_footprint_flush(writer->footprint, writer->out, writer->format) < 0)
+    ret = -1;
+  if (writer->out != NULL && fflush(writer->out) != 0)
+    ret = -1;
+  return ret;
+}
+
+/*****************************************************************************
+ * libklv_writer_finish
+ *
+ * Write out anything the writer still holds back, i.e. the last archive
+ * block, footprint batch or aggregation window. Must be called before the
+ * output stream is closed.
+ *****************************************************************************/
+int libklv_writer_finish(klv_writer_t *writer) {
+  int ret = libklv_archive_writer_finish(writer->archive);
+
+  writer->archive = NULL;
+  if (writer->footprint != NULL) {
+    if (libklv_footprint_flush(writer->footprint, writer->out, writer->format) < 0)
+      ret = -1;
+    libklv_footprint_cleanup(writer->footprint);
+    writer->footprint = NULL;
+  }
+  if (writer->aggregate != NULL && libklv_aggregate_flush(writer->aggregate, writer->out) < 0)
+    ret = -1;
+  return ret;
+}
@@ -0,0 +1,72 @@
+#ifndef LIBKLV_OUTPUT_H_INCLUDED
+#define LIBKLV_OUTPUT_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "libklv_time.h"
+#include "list.h"
+
+typedef enum klv_output_format_e {
+  LIBKLV_OUTPUT_NONE = 0, /* decode only */
+  LIBKLV_OUTPUT_JSON,     /* one JSON object per line, values quoted as strings */
+  LIBKLV_OUTPUT_MSGPACK,  /* one MessagePack map per packet: tag id -> typed value */
+  LIBKLV_OUTPUT_CBOR,     /* one CBOR map per packet: tag id -> typed value */
+  LIBKLV_OUTPUT_RECORD,   /* length-prefixed fixed-layout records, see klv_record_t */
+  LIBKLV_OUTPUT_ARCHIVE,  /* delta/varint coded blocks of raw values, see libklv_archive.h */
+  LIBKLV_OUTPUT_GEOJSON,  /* one GeoJSON footprint polygon per frame, see libklv_footprint.h */
+  LIBKLV_OUTPUT_WKB,      /* one WKB footprint polygon per frame */
+} klv_output_format_t;
+
+/* type of a value in a klv_record_entry_t */
+typedef enum klv_value_type_e {
+  KLV_VALUE_NONE = 0, /* no value, e.g. out of range or not decoded */
+  KLV_VALUE_UINT,     /* value.u */
+  KLV_VALUE_INT,      /* value.i */
+  KLV_VALUE_DOUBLE,   /* value.d, the mapped value */
+  KLV_VALUE_STRING,   /* len bytes at data_offset, null-terminated */
+  KLV_VALUE_BYTES,    /* len bytes at data_offset */
+} klv_value_type_t;
+
+/*
+ * LIBKLV_OUTPUT_RECORD layout, in host byte order. Each packet is a record
+ * header followed by count entries and then the variable length data they
+ * point to. size is always a multiple of 8, so a file of records can be
+ * mmapped and walked in place by stepping size bytes at a time.
+ */
+typedef struct klv_record_s {
+  uint32_t size;  /* size of the whole record in bytes, header included */
+  uint16_t count; /* number of entries following the header */
+  uint16_t reserved;
+} klv_record_t;
+
+typedef struct klv_record_entry_s {
+  uint8_t id;           /* ST0601 tag */
+  uint8_t type;         /* klv_value_type_t */
+  uint16_t len;         /* length of the data at data_offset */
+  uint32_t data_offset; /* offset of variable length data from the start of the record */
+  union {
+    uint64_t u;
+    int64_t i;
+    double d;
+  } value;
+} klv_record_entry_t;
+
+typedef struct klv_writer_s {
+  FILE *out;               /* destination stream */
+  uint8_t format;          /* klv_output_format_t */
+  klv_time_fmt_t time_fmt; /* cached text of the last precision time stamp */
+  struct klv_archive_writer_s *archive; /* block being built, LIBKLV_OUTPUT_ARCHIVE only */
+  struct klv_footprint_s *footprint;    /* frames being gathered, LIBKLV_OUTPUT_GEOJSON/WKB only */
+  struct klv_aggregate_s *aggregate;    /* when set, packets are summarized per window instead of written */
+  struct klv_publish_s *publish;        /* when set, each packet also updates the published state */
+} klv_writer_t;
+
+/*
+ * Global prototypes
+ */
+int libklv_write_packet(klv_writer_t *writer, const struct list_head *first, const struct list_head *end);
+int libklv_writer_flush(klv_writer_t *writer);
+int libklv_writer_finish(klv_writer_t *writer);
+
+#endif // LIBKLV_OUTPUT_H_INCLUDED
@@ -0,0 +1,235 @@
+#include "libklv_publish.h"
+
+#if defined(_WIN32)
+
+klv_publish_t *libklv_publish_create(const char *name) {
+  (void)name;
+  return NULL;
+}
+
+klv_publish_t *libklv_publish_open(const char *name) {
+  (void)name;
+  return NULL;
+}
+
+int libklv_publish_packet(klv_publish_t *publish, const struct list_head *first, const struct list_head *end) {
+  (void)publish;
+  (void)first;
+  (void)end;
+  return -1;
+}
+
+int libklv_publish_read(const klv_publish_t *publish, klv_state_t *state, uint64_t *packets) {
+  (void)publish;
+  (void)state;
+  (void)packets;
+  return -1;
+}
+
+void libklv_publish_close(klv_publish_t *publish) {
+  (void)publish;
+}
+
+int libklv_publish_unlink(const char *name) {
+  (void)name;
+  return -1;
+}
+
+#else
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RECORD_WORDS (1 + (sizeof(klv_state_t) + 7) / 8) /* packets, then the state */
+#define READ_ATTEMPTS 65536 /* before a reader gives up on a record that stays mid-update */
+
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the sequence lock needs address-free 64-bit atomics");
+
+typedef struct segment_s {
+  _Atomic uint32_t magic; /* stored last, once the segment is initialized */
+  uint32_t version;
+  uint32_t state_size;
+  uint32_t reserved;
+  _Atomic uint64_t seq;
+  _Atomic uint64_t record[RECORD_WORDS]; /* accessed word by word, so that racing reads are defined */
+} segment_t;
+
+struct klv_publish_s {
+  segment_t *segment;
+  bool writer;
+  uint64_t seq;        /* writer only: the last even sequence number stored */
+  uint64_t packets;    /* writer only */
+  klv_state_t state;   /* writer only: the state being carried forward */
+};
+
+/*****************************************************************************
+ * segment_name
+ *
+ * shm_open wants a single leading slash; add it when name lacks one.
+ *****************************************************************************/
+static int segment_name(const char *name, char *buf, size_t size) {
+  int n = snprintf(buf, size, "%s%s", (name[0] == '/') ? "" : "/", name);
+  return (n > 1 && (size_t)n < size) ? 0 : -1;
+}
+
+/*****************************************************************************
+ * map_segment
+ *****************************************************************************/
+static klv_publish_t *map_segment(const char *name, bool writer) {
+  char path[256];
+  struct stat st;
+  klv_publish_t *publish = NULL;
+
+  if (segment_name(name, path, sizeof(path)) < 0)
+    return NULL;
+  int fd = shm_open(path, writer ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+  if (fd < 0)
+    return NULL;
+  if (writer && ftruncate(fd, sizeof(segment_t)) < 0)
+    goto close_fd;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(segment_t))
+    goto close_fd;
+
+  publish = (klv_publish_t *)calloc(1, sizeof(klv_publish_t));
+  if (publish == NULL)
+    goto close_fd;
+  void *p = mmap(NULL, sizeof(segment_t), writer ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    free(publish);
+    publish = NULL;
+    goto close_fd;
+  }
+  publish->segment = (segment_t *)p;
+  publish->writer = writer;
+
+close_fd:
+  close(fd);
+  return publish;
+}
+
+/*****************************************************************************
+ * libklv_publish_create
+ *
+ * Create or take over the segment name as its writer.
+ *****************************************************************************/
+klv_publish_t *libklv_publish_create(const char *name) {
+  klv_publish_t *publish = map_segment(name, true);
+  if (publish == NULL)
+    return NULL;
+
+  segment_t *segment = publish->segment;
+  /* readers of a previous writer may still be mapped, so keep the sequence moving forward */
+  publish->seq = (atomic_load_explicit(&segment->seq, memory_order_relaxed) + 1) & ~UINT64_C(1);
+  atomic_store_explicit(&segment->seq, publish->seq, memory_order_relaxed);
+  segment->version = LIBKLV_PUBLISH_VERSION;
+  segment->state_size = sizeof(klv_state_t);
+  segment->reserved = 0;
+  atomic_store_explicit(&segment->magic, LIBKLV_PUBLISH_MAGIC, memory_order_release);
+  return publish;
+}
+
+/*****************************************************************************
+ * libklv_publish_open
+ *
+ * Map the segment name read-only. Returns NULL if it does not exist or was
+ * written by an incompatible version.
+ *****************************************************************************/
+klv_publish_t *libklv_publish_open(const char *name) {
+  klv_publish_t *publish = map_segment(name, false);
+  if (publish == NULL)
+    return NULL;
+
+  const segment_t *segment = publish->segment;
+  if (atomic_load_explicit(&segment->magic, memory_order_acquire) != LIBKLV_PUBLISH_MAGIC ||
+      segment->version != LIBKLV_PUBLISH_VERSION || segment->state_size != sizeof(klv_state_t)) {
+    libklv_publish_close(publish);
+    return NULL;
+  }
+  return publish;
+}
+
+/*****************************************************************************
+ * libklv_publish_packet
+ *
+ * Fold the items [first, end) of one decoded packet into the stream's state
+ * and publish it.
+ *****************************************************************************/
+int libklv_publish_packet(klv_publish_t *publish, const struct list_head *first, const struct list_head *end) {
+  uint64_t words[RECORD_WORDS];
+  segment_t *segment = publish->segment;
+
+  if (!publish->writer)
+    return -1;
+
+  libklv_update_state(&publish->state, first, end);
+  words[0] = ++publish->packets;
+  memcpy(&words[1], &publish->state, sizeof(klv_state_t));
+
+  /* odd: readers that overlap the stores below will see seq change and retry */
+  atomic_store_explicit(&segment->seq, publish->seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  for (size_t i = 0; i < RECORD_WORDS; i++)
+    atomic_store_explicit(&segment->record[i], words[i], memory_order_relaxed);
+  publish->seq += 2;
+  atomic_store_explicit(&segment->seq, publish->seq, memory_order_release);
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_publish_read
+ *
+ * Copy a consistent snapshot of the record. Returns 1 with state and packets
+ * set, 0 if nothing has been published yet and -1 if the record was being
+ * updated on each of READ_ATTEMPTS tries, e.g. because the writer was
+ * preempted or died in the middle; the call can simply be repeated.
+ *****************************************************************************/
+int libklv_publish_read(const klv_publish_t *publish, klv_state_t *state, uint64_t *packets) {
+  uint64_t words[RECORD_WORDS];
+  const segment_t *segment = publish->segment;
+
+  for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+    uint64_t before = atomic_load_explicit(&segment->seq, memory_order_acquire);
+    if (before & 1)
+      continue;
+    for (size_t i = 0; i < RECORD_WORDS; i++)
+      words[i] = atomic_load_explicit(&segment->record[i], memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&segment->seq, memory_order_relaxed) != before)
+      continue;
+
+    if (words[0] == 0)
+      return 0;
+    *packets = words[0];
+    memcpy(state, &words[1], sizeof(klv_state_t));
+    return 1;
+  }
+  return -1;
+}
+
+/*****************************************************************************
+ * libklv_publish_close
+ *
+ * Unmap the segment, which keeps its last state for other readers.
+ *****************************************************************************/
+void libklv_publish_close(klv_publish_t *publish) {
+  if (publish == NULL)
+    return;
+  munmap(publish->segment, sizeof(segment_t));
+  free(publish);
+}
+
+/*****************************************************************************
+ * libklv_publish_unlink
+ *****************************************************************************/
+int libklv_publish_unlink(const char *name) {
+  char path[256];
+
+  if (segment_name(name, path, sizeof(path)) < 0)
+    return -1;
+  return shm_unlink(path);
+}
+
+#endif
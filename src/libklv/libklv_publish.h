@@ -0,0 +1,43 @@
+#ifndef LIBKLV_PUBLISH_H_INCLUDED
+#define LIBKLV_PUBLISH_H_INCLUDED
+
+#include <stdint.h>
+
+#include "libklv_state.h"
+#include "list.h"
+
+#define LIBKLV_PUBLISH_MAGIC 0x534B4C4B /* "KLKS" in little-endian memory */
+#define LIBKLV_PUBLISH_VERSION 1
+
+/*
+ * The latest state of one stream, published in a POSIX shared-memory segment
+ * so that any number of local processes can follow it while the stream is
+ * decoded once. The segment holds a single fixed-layout record guarded by a
+ * sequence lock, in host byte order:
+ *
+ *   uint32_t magic, version   LIBKLV_PUBLISH_MAGIC, LIBKLV_PUBLISH_VERSION
+ *   uint32_t state_size       sizeof(klv_state_t)
+ *   uint32_t reserved
+ *   uint64_t seq              odd while the writer is updating the record
+ *   uint64_t packets          packets published so far
+ *   klv_state_t state         fields missing from a packet carried forward
+ *
+ * Readers map the segment read-only and copy the record between two reads
+ * of seq, retrying if it was odd or changed, so a snapshot is consistent
+ * without locks and, once mapped, without system calls. There must be a
+ * single writer per segment. The segment outlives the writer and keeps the
+ * last state until libklv_publish_unlink removes it.
+ */
+typedef struct klv_publish_s klv_publish_t;
+
+/*
+ * Global prototypes
+ */
+klv_publish_t *libklv_publish_create(const char *name);
+klv_publish_t *libklv_publish_open(const char *name);
+int libklv_publish_packet(klv_publish_t *publish, const struct list_head *first, const struct list_head *end);
+int libklv_publish_read(const klv_publish_t *publish, klv_state_t *state, uint64_t *packets);
+void libklv_publish_close(klv_publish_t *publish);
+int libklv_publish_unlink(const char *name);
+
+#endif // LIBKLV_PUBLISH_H_INCLUDED
@@ -0,0 +1,132 @@
+#include "libklv_reorder.h"
+#include "libklv.h"
+
+/*****************************************************************************
+ * before
+ *****************************************************************************/
+static inline bool before(const klv_reorder_entry_t *a, const klv_reorder_entry_t *b) {
+  return (a->time < b->time) || (a->time == b->time && a->seq < b->seq);
+}
+
+/*****************************************************************************
+ * libklv_reorder_init
+ *****************************************************************************/
+int libklv_reorder_init(klv_reorder_t *reorder, uint64_t window, size_t capacity) {
+  memset(reorder, 0, sizeof(*reorder));
+  reorder->window = window;
+  reorder->capacity = (capacity > 0) ? capacity : 1;
+  reorder->heap = (klv_reorder_entry_t *)malloc(reorder->capacity * sizeof(klv_reorder_entry_t));
+  return (reorder->heap != NULL) ? 0 : -1;
+}
+
+/*****************************************************************************
+ * libklv_reorder_cleanup
+ *
+ * Free the heap. Packets still held are the caller's to release first.
+ *****************************************************************************/
+void libklv_reorder_cleanup(klv_reorder_t *reorder) {
+  free(reorder->heap);
+  reorder->heap = NULL;
+  reorder->count = 0;
+}
+
+/*****************************************************************************
+ * libklv_reorder_reset
+ *
+ * Forget the time stamps released so far, for a stream that starts over.
+ * Packets still held are the caller's to pop with flush first.
+ *****************************************************************************/
+void libklv_reorder_reset(klv_reorder_t *reorder) {
+  reorder->newest = 0;
+  reorder->released = 0;
+  reorder->has_released = false;
+}
+
+/*****************************************************************************
+ * libklv_packet_time
+ *
+ * Precision time stamp of the decoded packet [first, end), if it has one.
+ *****************************************************************************/
+bool libklv_packet_time(const struct list_head *first, const struct list_head *end, uint64_t *time) {
+  const struct list_head *pos;
+
+  for (pos = first; pos != end; pos = pos->next) {
+    const klv_item_t *item = list_entry(pos, klv_item_t, list);
+    if (item->id == 0x02 && item->raw != NULL) {
+      *time = item->value;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*****************************************************************************
+ * libklv_reorder_push
+ *
+ * Hold packet until it is due. Returns 0 when it is held, 1 when it is late
+ * and was not taken, and -1 when the reorder buffer is full; pop a packet
+ * with flush set to make room.
+ *****************************************************************************/
+int libklv_reorder_push(klv_reorder_t *reorder, uint64_t time, void *packet) {
+  if (reorder->has_released && time < reorder->released) {
+    reorder->late++;
+    return 1;
+  }
+  if (reorder->count == reorder->capacity)
+    return -1;
+
+  /* sift up */
+  klv_reorder_entry_t entry = {.time = time, .seq = reorder->seq++, .packet = packet};
+  size_t i = reorder->count++;
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!before(&entry, &reorder->heap[parent]))
+      break;
+    reorder->heap[i] = reorder->heap[parent];
+    i = parent;
+  }
+  reorder->heap[i] = entry;
+
+  if (time > reorder->newest)
+    reorder->newest = time;
+  return 0;
+}
+
+/*****************************************************************************
+ * libklv_reorder_pop
+ *
+ * The earliest held packet if it is due, i.e. a packet window newer has been
+ * pushed, the buffer is full or flush is set. NULL otherwise.
+ *****************************************************************************/
+void *libklv_reorder_pop(klv_reorder_t *reorder, bool flush) {
+  if (reorder->count == 0)
+    return NULL;
+
+  klv_reorder_entry_t *top = &reorder->heap[0];
+  if (!flush && reorder->count < reorder->capacity && reorder->newest - top->time < reorder->window)
+    return NULL;
+
+  void *packet = top->packet;
+  reorder->released = top->time;
+  reorder->has_released = true;
+
+  /* sift down the last entry from the root */
+  klv_reorder_entry_t last = reorder->heap[--reorder->count];
+  size_t n = reorder->count;
+  size_t i = 0;
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= n)
+      break;
+    if (child + 1 < n && before(&reorder->heap[child + 1], &reorder->heap[child]))
+      child++;
+    if (!before(&reorder->heap[child], &last))
+      break;
+    reorder->heap[i] = reorder->heap[child];
+    i = child;
+  }
+  if (n > 0)
+    reorder->heap[i] = last;
+
+  return packet;
+}
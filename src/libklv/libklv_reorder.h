@@ -0,0 +1,49 @@
+#ifndef LIBKLV_REORDER_H_INCLUDED
+#define LIBKLV_REORDER_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "list.h"
+
+/* one held packet; seq keeps packets with equal time stamps in arrival order */
+typedef struct klv_reorder_entry_s {
+  uint64_t time;
+  uint64_t seq;
+  void *packet;
+} klv_reorder_entry_t;
+
+/*
+ * Puts packets that arrive slightly out of order back in precision time stamp
+ * (0x02) order. A packet is held until one at least window microseconds newer
+ * has arrived, or until capacity packets are held, so the delay is bounded in
+ * stream time and in memory. A packet older than one already released cannot
+ * be placed any more and is counted as late instead of being held.
+ *
+ * Packets are opaque pointers owned by the caller, e.g. whole decoding
+ * contexts, so nothing is copied in and out of the buffer.
+ */
+typedef struct klv_reorder_s {
+  uint64_t window;            /* hold time in microseconds of stream time */
+  size_t capacity;            /* most packets held at once */
+  size_t count;               /* packets held */
+  klv_reorder_entry_t *heap;  /* min-heap on (time, seq) */
+  uint64_t seq;               /* packets pushed so far */
+  uint64_t newest;            /* latest time stamp pushed */
+  uint64_t released;          /* time stamp of the last packet popped */
+  bool has_released;
+  uint64_t late;              /* packets refused because they arrived too late */
+} klv_reorder_t;
+
+/*
+ * Global prototypes
+ */
+int libklv_reorder_init(klv_reorder_t *reorder, uint64_t window, size_t capacity);
+void libklv_reorder_cleanup(klv_reorder_t *reorder);
+void libklv_reorder_reset(klv_reorder_t *reorder);
+bool libklv_packet_time(const struct list_head *first, const struct list_head *end, uint64_t *time);
+int libklv_reorder_push(klv_reorder_t *reorder, uint64_t time, void *packet);
+void *libklv_reorder_pop(klv_reorder_t *reorder, bool flush);
+
+#endif // LIBKLV_REORDER_H_INCLUDED
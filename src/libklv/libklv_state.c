@@ -0,0 +1,182 @@
+#include "libklv_state.h"
+#include <float.h>
+#include <math.h>
+
+/* tag id -> klv_state_t field index + 1 (0 means the tag is not part of the state) */
+static const uint8_t state_field_of_tag[256] = {
+    [0x05] = KLV_STATE_PLATFORM_HEADING + 1,
+    [0x06] = KLV_STATE_PLATFORM_PITCH + 1,
+    [0x07] = KLV_STATE_PLATFORM_ROLL + 1,
+    [0x0D] = KLV_STATE_SENSOR_LATITUDE + 1,
+    [0x0E] = KLV_STATE_SENSOR_LONGITUDE + 1,
+    [0x0F] = KLV_STATE_SENSOR_ALTITUDE + 1,
+    [0x10] = KLV_STATE_SENSOR_HFOV + 1,
+    [0x11] = KLV_STATE_SENSOR_VFOV + 1,
+    [0x12] = KLV_STATE_SENSOR_REL_AZIMUTH + 1,
+    [0x13] = KLV_STATE_SENSOR_REL_ELEVATION + 1,
+    [0x14] = KLV_STATE_SENSOR_REL_ROLL + 1,
+    [0x15] = KLV_STATE_SLANT_RANGE + 1,
+    [0x17] = KLV_STATE_FRAME_CENTER_LATITUDE + 1,
+    [0x18] = KLV_STATE_FRAME_CENTER_LONGITUDE + 1,
+    [0x19] = KLV_STATE_FRAME_CENTER_ELEVATION + 1,
+};
+
+/* klv_state_t field index -> tag id, the inverse of state_field_of_tag */
+static const uint8_t state_tag_of_field[KLV_STATE_FIELD_COUNT] = {
+    0x05, 0x06, 0x07, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x17, 0x18, 0x19,
+};
+
+/*
+ * Angular fields wrap with the given period starting at the given lower bound.
+ * Linear fields have a period of 0, which turns the wrap arithmetic below into
+ * a no-op so every field goes through the same branch-free loop.
+ */
+static const double state_period[KLV_STATE_FIELD_COUNT] = {
+    [KLV_STATE_PLATFORM_HEADING] = 360.0,
+    [KLV_STATE_SENSOR_LONGITUDE] = 360.0,
+    [KLV_STATE_SENSOR_REL_AZIMUTH] = 360.0,
+    [KLV_STATE_SENSOR_REL_ELEVATION] = 360.0,
+    [KLV_STATE_SENSOR_REL_ROLL] = 360.0,
+    [KLV_STATE_FRAME_CENTER_LONGITUDE] = 360.0,
+};
+
+static const double state_inv_period[KLV_STATE_FIELD_COUNT] = {
+    [KLV_STATE_PLATFORM_HEADING] = 1.0 / 360.0,
+    [KLV_STATE_SENSOR_LONGITUDE] = 1.0 / 360.0,
+    [KLV_STATE_SENSOR_REL_AZIMUTH] = 1.0 / 360.0,
+    [KLV_STATE_SENSOR_REL_ELEVATION] = 1.0 / 360.0,
+    [KLV_STATE_SENSOR_REL_ROLL] = 1.0 / 360.0,
+    [KLV_STATE_FRAME_CENTER_LONGITUDE] = 1.0 / 360.0,
+};
+
+static const double state_lower_bound[KLV_STATE_FIELD_COUNT] = {
+    [KLV_STATE_SENSOR_LONGITUDE] = -180.0,
+    [KLV_STATE_SENSOR_REL_ELEVATION] = -180.0,
+    [KLV_STATE_SENSOR_REL_ROLL] = -180.0,
+    [KLV_STATE_FRAME_CENTER_LONGITUDE] = -180.0,
+};
+
+/*****************************************************************************
+ * interpolate_fields
+ *****************************************************************************/
+static inline void interpolate_fields(const double *a, const double *b, double w, double *out) {
+  for (int f = 0; f < KLV_STATE_FIELD_COUNT; f++) {
+    /* shortest arc: fold the difference into [-period/2, period/2] */
+    double d = b[f] - a[f];
+    d -= state_period[f] * rint(d * state_inv_period[f]);
+    double r = a[f] + (w * d);
+    /* bring the result back into [lower, lower + period) */
+    out[f] = r - (state_period[f] * floor((r - state_lower_bound[f]) * state_inv_period[f]));
+  }
+}
+
+/*****************************************************************************
+ * apply_item
+ *
+ * Update cur with one decoded item, if it is part of the state.
+ *****************************************************************************/
+static inline void apply_item(klv_state_t *cur, const klv_item_t *item) {
+  uint8_t field = state_field_of_tag[item->id];
+
+  if (field != 0) {
+    if (item->mapped_val != DBL_MIN) { /* DBL_MIN flags an out-of-range value */
+      cur->field[field - 1] = item->mapped_val;
+      cur->valid |= 1u << (field - 1);
+    }
+  } else if (item->id == 0x02) {
+    cur->timestamp = item->value;
+  }
+}
+
+/*****************************************************************************
+ * libklv_collect_states
+ *
+ * Flatten the items parsed into ctx into one klv_state_t per packet that
+ * carries a timestamp. ST0601 lets a packet omit values that have not changed,
+ * so fields missing from a packet are carried forward from the previous one.
+ * Returns the number of states written.
+ *****************************************************************************/
+size_t libklv_collect_states(const klv_ctx_t *ctx, klv_state_t *states, size_t max_states) {
+  const klv_item_t *item = NULL;
+  klv_state_t cur;
+  bool have_timestamp = false;
+  size_t count = 0;
+
+  memset(&cur, 0, sizeof(cur));
+
+  list_for_each_entry(item, &ctx->klv_items.list, list) {
+    if (count >= max_states)
+      break;
+
+    apply_item(&cur, item);
+    if (item->id == 0x02) {
+      have_timestamp = true;
+    } else if (item->id == 0x01) { /* checksum closes the packet */
+      if (have_timestamp)
+        states[count++] = cur;
+      have_timestamp = false;
+    }
+  }
+
+  return count;
+}
+
+/*****************************************************************************
+ * libklv_update_state
+ *
+ * Apply the items [first, end) of one decoded packet to state, keeping the
+ * fields the packet omits, as libklv_collect_states does from packet to packet.
+ *****************************************************************************/
+void libklv_update_state(klv_state_t *state, const struct list_head *first, const struct list_head *end) {
+  const struct list_head *pos;
+
+  for (pos = first; pos != end; pos = pos->next)
+    apply_item(state, list_entry(pos, klv_item_t, list));
+}
+
+/*****************************************************************************
+ * libklv_state_tag
+ *
+ * ST0601 tag of a klv_state_t field.
+ *****************************************************************************/
+uint8_t libklv_state_tag(klv_state_field_t field) {
+  return state_tag_of_field[field];
+}
+
+/*****************************************************************************
+ * libklv_interpolate_states
+ *
+ * Resample states (sorted by timestamp) at each of times (also sorted) in a
+ * single merge pass. Positions are interpolated linearly and angles along the
+ * shortest arc. Times outside the covered span are clamped to the first or
+ * last state. Returns the number of states written to out (num_times, or 0 if
+ * there is nothing to interpolate from).
+ *****************************************************************************/
+size_t libklv_interpolate_states(const klv_state_t *states, size_t num_states,
+                                 const uint64_t *times, size_t num_times, klv_state_t *out) {
+  size_t j = 0;
+
+  if (num_states == 0)
+    return 0;
+
+  for (size_t i = 0; i < num_times; i++) {
+    uint64_t t = times[i];
+
+    /* advance to the last state at or before t */
+    while (j + 1 < num_states && states[j + 1].timestamp <= t)
+      j++;
+
+    if (t <= states[j].timestamp || j + 1 == num_states) {
+      out[i] = states[j];
+    } else {
+      const klv_state_t *a = &states[j];
+      const klv_state_t *b = &states[j + 1];
+      double w = (double)(t - a->timestamp) / (double)(b->timestamp - a->timestamp);
+      interpolate_fields(a->field, b->field, w, out[i].field);
+      out[i].valid = a->valid & b->valid;
+    }
+    out[i].timestamp = t;
+  }
+
+  return num_times;
+}
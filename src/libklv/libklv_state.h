@@ -0,0 +1,42 @@
+#ifndef LIBKLV_STATE_H_INCLUDED
+#define LIBKLV_STATE_H_INCLUDED
+
+#include "libklv.h"
+
+/* indices into klv_state_t.field. each entry is the mapped value of one ST0601 tag */
+typedef enum klv_state_field_e {
+  KLV_STATE_PLATFORM_HEADING = 0,  /* 0x05 */
+  KLV_STATE_PLATFORM_PITCH,        /* 0x06 */
+  KLV_STATE_PLATFORM_ROLL,         /* 0x07 */
+  KLV_STATE_SENSOR_LATITUDE,       /* 0x0D */
+  KLV_STATE_SENSOR_LONGITUDE,      /* 0x0E */
+  KLV_STATE_SENSOR_ALTITUDE,       /* 0x0F */
+  KLV_STATE_SENSOR_HFOV,           /* 0x10 */
+  KLV_STATE_SENSOR_VFOV,           /* 0x11 */
+  KLV_STATE_SENSOR_REL_AZIMUTH,    /* 0x12 */
+  KLV_STATE_SENSOR_REL_ELEVATION,  /* 0x13 */
+  KLV_STATE_SENSOR_REL_ROLL,       /* 0x14 */
+  KLV_STATE_SLANT_RANGE,           /* 0x15 */
+  KLV_STATE_FRAME_CENTER_LATITUDE, /* 0x17 */
+  KLV_STATE_FRAME_CENTER_LONGITUDE, /* 0x18 */
+  KLV_STATE_FRAME_CENTER_ELEVATION, /* 0x19 */
+  KLV_STATE_FIELD_COUNT
+} klv_state_field_t;
+
+/* platform and sensor state at a single instant, flattened from one decoded packet */
+typedef struct klv_state_s {
+  uint64_t timestamp; /* microseconds since 00:00:00:00, January 1st 1970 (tag 0x02) */
+  uint32_t valid;     /* bit n set when field[n] holds a value */
+  double field[KLV_STATE_FIELD_COUNT];
+} klv_state_t;
+
+/*
+ * Global prototypes
+ */
+size_t libklv_collect_states(const klv_ctx_t *ctx, klv_state_t *states, size_t max_states);
+void libklv_update_state(klv_state_t *state, const struct list_head *first, const struct list_head *end);
+uint8_t libklv_state_tag(klv_state_field_t field);
+size_t libklv_interpolate_states(const klv_state_t *states, size_t num_states,
+                                 const uint64_t *times, size_t num_times, klv_state_t *out);
+
+#endif // LIBKLV_STATE_H_INCLUDED
@@ -0,0 +1,85 @@
+#include "libklv_tags.h"
+#include <stddef.h>
+#include <string.h>
+
+/* the tag exists in the table's version as kind, or as KLV_TYPE_LATER */
+#define KLV_KIND(in, kind) ((in) ? (kind) : KLV_TYPE_LATER)
+#define KLV_UINT(in, w, lo, hi, n) {.len = (w), .type = KLV_KIND(in, KLV_TYPE_UINT), .min = (lo), .max = (hi), .name = #n}
+#define KLV_INT(in, w, lo, hi, n) {.len = (w), .type = KLV_KIND(in, KLV_TYPE_INT), .min = (lo), .max = (hi), .name = #n}
+#define KLV_STRING(in, w, lo, hi, n) {.len = (w), .type = KLV_KIND(in, KLV_TYPE_STRING), .name = #n}
+#define KLV_BYTES(in, w, lo, hi, n) {.len = (w), .type = KLV_KIND(in, KLV_TYPE_BYTES), .name = #n}
+#define KLV_ENUM(in, w, lo, hi, n)                                                                                     \
+  {.len = (w), .type = KLV_KIND(in, KLV_TYPE_UINT), .num_values = sizeof(n##_values) / sizeof(n##_values[0]) - 1,     \
+   .values = n##_values, .name = #n}
+#define KLV_TAG(v, kind, id, type, n, w, lo, hi, since) [id] = KLV_##kind((v) >= (since), w, lo, hi, n),
+
+/* names of the values of the ENUM tags, then of any other value (NULL for none) */
+static const char *const icing_detected_values[] = {"detector off", "no icing detected", "icing detected", "unsupported value"};
+static const char *const sensor_fov_name_values[] = {"Ultranarrow", "Narrow", "Medium", "Wide", "Ultrawide", "Narrow Medium", "2x Ultranarrow", "4x Ultranarrow", NULL};
+static const char *const operational_mode_values[] = {"Other", "Operational", "Training", "Exercise", "Maintenance", "Test", "Unknown"};
+
+/*
+ * MISB ST0601 local set as UAS LS version v (tag 0x41) defines it, ranges as
+ * interpreted by decode_klv_values. Tags a later version added are
+ * KLV_TYPE_LATER in the tables of earlier versions.
+ */
+#define ST0601_TAGS(v) LIBKLV_ST0601_TAG_LIST(KLV_TAG, v)
+
+/* the version bands in which the set changed */
+static const klv_tag_desc_t st0601_v4[256] = {ST0601_TAGS(4)}; /* up to ST0601.4 */
+static const klv_tag_desc_t st0601_v5[256] = {ST0601_TAGS(5)}; /* full range corners and angles */
+static const klv_tag_desc_t st0601_v6[256] = {ST0601_TAGS(6)}; /* MIIS core identifier */
+static const klv_tag_desc_t st0601_v8[256] = {ST0601_TAGS(8)}; /* SAR motion imagery, ST0601.7 and .8 */
+const klv_tag_desc_t libklv_tags[256] = {ST0601_TAGS(LIBKLV_ST0601_VERSION)};
+
+/*****************************************************************************
+ * libklv_tag_desc
+ *****************************************************************************/
+const klv_tag_desc_t *libklv_tag_desc(uint8_t id) {
+  return (libklv_tags[id].type != KLV_TYPE_NONE) ? &libklv_tags[id] : NULL;
+}
+
+/*****************************************************************************
+ * libklv_tag_table
+ *
+ * The 256 tag descriptors of UAS LS version (tag 0x41). Version 0, used for
+ * pre-release and test data, and versions newer than libklv knows get the
+ * newest table, libklv_tags.
+ *****************************************************************************/
+const klv_tag_desc_t *libklv_tag_table(uint8_t version) {
+  static const klv_tag_desc_t *const tables[LIBKLV_ST0601_VERSION] = {
+      libklv_tags, st0601_v4, st0601_v4, st0601_v4, st0601_v4, st0601_v5, st0601_v6, st0601_v8, st0601_v8,
+  };
+  return (version < LIBKLV_ST0601_VERSION) ? tables[version] : libklv_tags;
+}
+
+/*****************************************************************************
+ * libklv_tag_by_name
+ *****************************************************************************/
+int libklv_tag_by_name(const char *name) {
+  for (int id = 0; id < 256; id++) {
+    if (libklv_tags[id].name != NULL && strcmp(libklv_tags[id].name, name) == 0)
+      return id;
+  }
+  return -1;
+}
+
+/*****************************************************************************
+ * libklv_tag_raw_min
+ *****************************************************************************/
+double libklv_tag_raw_min(const klv_tag_desc_t *desc) {
+  if (desc->type == KLV_TYPE_INT)
+    return -(double)((UINT64_C(1) << (8 * desc->len - 1)) - 1);
+  return 0.0;
+}
+
+/*****************************************************************************
+ * libklv_tag_raw_max
+ *****************************************************************************/
+double libklv_tag_raw_max(const klv_tag_desc_t *desc) {
+  if (desc->type == KLV_TYPE_INT)
+    return (double)((UINT64_C(1) << (8 * desc->len - 1)) - 1);
+  if (desc->len >= 8)
+    return (double)UINT64_MAX;
+  return (double)((UINT64_C(1) << (8 * desc->len)) - 1);
+}
@@ -0,0 +1,151 @@
+#ifndef LIBKLV_TAGS_H_INCLUDED
+#define LIBKLV_TAGS_H_INCLUDED
+
+#include <stdint.h>
+
+#define LIBKLV_ST0601_VERSION 9 /* newest UAS LS version (tag 0x41) whose set libklv_tags describes */
+
+/*
+ * The ST0601 tags libklv knows, one X(a, kind, id, Type, name, width, min,
+ * max.0, since.0) per tag, from which both libklv_tags.c and libklv_tags.hpp
+ * build their descriptions. kind is UINT, INT, STRING, BYTES or ENUM (an
+ * unsigned integer whose values are named), Type the klv::tag struct, width
+ * 0 for variable length and since the UAS LS version that added the tag, 0
+ * for all of them. a is passed through to X unchanged.
+ */
+#define LIBKLV_ST0601_TAG_LIST(X, a)                                                                             \
+  X(a, UINT, 0x01, Checksum, checksum, 2, 0.0, 0.0, 0)                                                           \
+  X(a, UINT, 0x02, PrecisionTimeStamp, precision_time_stamp, 8, 0.0, 0.0, 0)                                     \
+  X(a, STRING, 0x03, MissionId, mission_id, 0, 0.0, 0.0, 0)                                                      \
+  X(a, STRING, 0x04, PlatformTailNumber, platform_tail_number, 0, 0.0, 0.0, 0)                                   \
+  X(a, UINT, 0x05, PlatformHeading, platform_heading, 2, 0.0, 360.0, 0)                                          \
+  X(a, INT, 0x06, PlatformPitch, platform_pitch, 2, -20.0, 20.0, 0)                                              \
+  X(a, INT, 0x07, PlatformRoll, platform_roll, 2, -50.0, 50.0, 0)                                                \
+  X(a, UINT, 0x08, PlatformTrueAirspeed, platform_true_airspeed, 1, 0.0, 0.0, 0)                                 \
+  X(a, UINT, 0x09, PlatformIndicatedAirspeed, platform_indicated_airspeed, 1, 0.0, 0.0, 0)                       \
+  X(a, STRING, 0x0A, PlatformDesignation, platform_designation, 0, 0.0, 0.0, 0)                                  \
+  X(a, STRING, 0x0B, ImageSourceSensor, image_source_sensor, 0, 0.0, 0.0, 0)                                     \
+  X(a, STRING, 0x0C, ImageCoordinateSystem, image_coordinate_system, 0, 0.0, 0.0, 0)                             \
+  X(a, INT, 0x0D, SensorLatitude, sensor_latitude, 4, -90.0, 90.0, 0)                                            \
+  X(a, INT, 0x0E, SensorLongitude, sensor_longitude, 4, -180.0, 180.0, 0)                                        \
+  X(a, UINT, 0x0F, SensorTrueAltitude, sensor_true_altitude, 2, -900.0, 19000.0, 0)                              \
+  X(a, UINT, 0x10, SensorHorizontalFov, sensor_horizontal_fov, 2, 0.0, 180.0, 0)                                 \
+  X(a, UINT, 0x11, SensorVerticalFov, sensor_vertical_fov, 2, 0.0, 180.0, 0)                                     \
+  X(a, UINT, 0x12, SensorRelativeAzimuth, sensor_relative_azimuth, 4, 0.0, 360.0, 0)                             \
+  X(a, INT, 0x13, SensorRelativeElevation, sensor_relative_elevation, 4, -180.0, 180.0, 0)                       \
+  X(a, UINT, 0x14, SensorRelativeRoll, sensor_relative_roll, 4, -180.0, 180.0, 0)                                \
+  X(a, UINT, 0x15, SlantRange, slant_range, 4, 0.0, 5000000.0, 0)                                                \
+  X(a, UINT, 0x16, TargetWidth, target_width, 2, 0.0, 10000.0, 0)                                                \
+  X(a, INT, 0x17, FrameCenterLatitude, frame_center_latitude, 4, -90.0, 90.0, 0)                                 \
+  X(a, INT, 0x18, FrameCenterLongitude, frame_center_longitude, 4, -180.0, 180.0, 0)                             \
+  X(a, UINT, 0x19, FrameCenterElevation, frame_center_elevation, 2, -900.0, 19000.0, 0)                          \
+  X(a, INT, 0x1A, OffsetCornerLatitude1, offset_corner_latitude_1, 2, -0.075, 0.075, 0)                          \
+  X(a, INT, 0x1B, OffsetCornerLongitude1, offset_corner_longitude_1, 2, -0.075, 0.075, 0)                        \
+  X(a, INT, 0x1C, OffsetCornerLatitude2, offset_corner_latitude_2, 2, -0.075, 0.075, 0)                          \
+  X(a, INT, 0x1D, OffsetCornerLongitude2, offset_corner_longitude_2, 2, -0.075, 0.075, 0)                        \
+  X(a, INT, 0x1E, OffsetCornerLatitude3, offset_corner_latitude_3, 2, -0.075, 0.075, 0)                          \
+  X(a, INT, 0x1F, OffsetCornerLongitude3, offset_corner_longitude_3, 2, -0.075, 0.075, 0)                        \
+  X(a, INT, 0x20, OffsetCornerLatitude4, offset_corner_latitude_4, 2, -0.075, 0.075, 0)                          \
+  X(a, INT, 0x21, OffsetCornerLongitude4, offset_corner_longitude_4, 2, -0.075, 0.075, 0)                        \
+  X(a, ENUM, 0x22, IcingDetected, icing_detected, 1, 0.0, 0.0, 0)                                                \
+  X(a, UINT, 0x23, WindDirection, wind_direction, 2, 0.0, 360.0, 0)                                              \
+  X(a, UINT, 0x24, WindSpeed, wind_speed, 1, 0.0, 100.0, 0)                                                      \
+  X(a, UINT, 0x25, StaticPressure, static_pressure, 2, 0.0, 5000.0, 0)                                           \
+  X(a, UINT, 0x26, DensityAltitude, density_altitude, 2, -900.0, 19000.0, 0)                                     \
+  X(a, INT, 0x27, OutsideAirTemperature, outside_air_temperature, 1, 0.0, 0.0, 0)                                \
+  X(a, INT, 0x28, TargetLocationLatitude, target_location_latitude, 4, -90.0, 90.0, 0)                           \
+  X(a, INT, 0x29, TargetLocationLongitude, target_location_longitude, 4, -180.0, 180.0, 0)                       \
+  X(a, UINT, 0x2A, TargetLocationElevation, target_location_elevation, 2, -900.0, 19000.0, 0)                    \
+  X(a, UINT, 0x2B, TargetTrackGateWidth, target_track_gate_width, 1, 0.0, 512.0, 0)                              \
+  X(a, UINT, 0x2C, TargetTrackGateHeight, target_track_gate_height, 1, 0.0, 512.0, 0)                            \
+  X(a, UINT, 0x2D, TargetErrorEstimateCe90, target_error_estimate_ce90, 2, 0.0, 4095.0, 0)                       \
+  X(a, UINT, 0x2E, TargetErrorEstimateLe90, target_error_estimate_le90, 2, 0.0, 4095.0, 0)                       \
+  X(a, UINT, 0x2F, GenericFlagData01, generic_flag_data_01, 1, 0.0, 0.0, 0)                                      \
+  X(a, BYTES, 0x30, SecurityLocalMetadataSet, security_local_metadata_set, 0, 0.0, 0.0, 0)                       \
+  X(a, UINT, 0x31, DifferentialPressure, differential_pressure, 2, 0.0, 5000.0, 0)                               \
+  X(a, INT, 0x32, PlatformAngleOfAttack, platform_angle_of_attack, 2, -20.0, 20.0, 0)                            \
+  X(a, INT, 0x33, PlatformVerticalSpeed, platform_vertical_speed, 2, -180.0, 180.0, 0)                           \
+  X(a, INT, 0x34, PlatformSideslipAngle, platform_sideslip_angle, 2, -20.0, 20.0, 0)                             \
+  X(a, UINT, 0x35, AirfieldBarometricPressure, airfield_barometric_pressure, 2, 0.0, 5000.0, 0)                  \
+  X(a, UINT, 0x36, AirfieldElevation, airfield_elevation, 2, -900.0, 19000.0, 0)                                 \
+  X(a, UINT, 0x37, RelativeHumidity, relative_humidity, 1, 0.0, 100.0, 0)                                        \
+  X(a, UINT, 0x38, PlatformGroundSpeed, platform_ground_speed, 1, 0.0, 0.0, 0)                                   \
+  X(a, UINT, 0x39, GroundRange, ground_range, 4, 0.0, 5000000.0, 0)                                              \
+  X(a, UINT, 0x3A, PlatformFuelRemaining, platform_fuel_remaining, 2, 0.0, 10000.0, 0)                           \
+  X(a, STRING, 0x3B, PlatformCallSign, platform_call_sign, 0, 0.0, 0.0, 0)                                       \
+  X(a, UINT, 0x3C, WeaponLoad, weapon_load, 2, 0.0, 0.0, 0)                                                      \
+  X(a, UINT, 0x3D, WeaponFired, weapon_fired, 1, 0.0, 0.0, 0)                                                    \
+  X(a, UINT, 0x3E, LaserPrfCode, laser_prf_code, 2, 0.0, 0.0, 0)                                                 \
+  X(a, ENUM, 0x3F, SensorFovName, sensor_fov_name, 1, 0.0, 0.0, 0)                                               \
+  X(a, UINT, 0x40, PlatformMagneticHeading, platform_magnetic_heading, 2, 0.0, 360.0, 0)                         \
+  X(a, UINT, 0x41, UasLsVersionNumber, uas_ls_version_number, 1, 0.0, 0.0, 0)                                    \
+  X(a, BYTES, 0x42, TargetLocationCovarianceMatrix, target_location_covariance_matrix, 0, 0.0, 0.0, 0)           \
+  X(a, INT, 0x43, AlternatePlatformLatitude, alternate_platform_latitude, 4, -90.0, 90.0, 0)                     \
+  X(a, INT, 0x44, AlternatePlatformLongitude, alternate_platform_longitude, 4, -180.0, 180.0, 0)                 \
+  X(a, UINT, 0x45, AlternatePlatformAltitude, alternate_platform_altitude, 2, -900.0, 19000.0, 0)                \
+  X(a, STRING, 0x46, AlternatePlatformName, alternate_platform_name, 0, 0.0, 0.0, 0)                             \
+  X(a, UINT, 0x47, AlternatePlatformHeading, alternate_platform_heading, 2, 0.0, 360.0, 0)                       \
+  X(a, UINT, 0x48, EventStartTime, event_start_time, 8, 0.0, 0.0, 0)                                             \
+  X(a, BYTES, 0x49, RvtLocalSet, rvt_local_set, 0, 0.0, 0.0, 0)                                                  \
+  X(a, BYTES, 0x4A, VmtiLocalSet, vmti_local_set, 0, 0.0, 0.0, 0)                                                \
+  X(a, UINT, 0x4B, SensorEllipsoidHeight, sensor_ellipsoid_height, 2, -900.0, 19000.0, 0)                        \
+  X(a, UINT, 0x4C, AlternatePlatformEllipsoidHeight, alternate_platform_ellipsoid_height, 2, -900.0, 19000.0, 0) \
+  X(a, ENUM, 0x4D, OperationalMode, operational_mode, 1, 0.0, 0.0, 0)                                            \
+  X(a, UINT, 0x4E, FrameCenterHeightAboveEllipsoid, frame_center_height_above_ellipsoid, 2, -900.0, 19000.0, 0)  \
+  X(a, INT, 0x4F, SensorNorthVelocity, sensor_north_velocity, 2, -327.0, 327.0, 0)                               \
+  X(a, INT, 0x50, SensorEastVelocity, sensor_east_velocity, 2, -327.0, 327.0, 0)                                 \
+  X(a, BYTES, 0x51, ImageHorizonPixelPack, image_horizon_pixel_pack, 0, 0.0, 0.0, 0)                             \
+  X(a, INT, 0x52, CornerLatitude1, corner_latitude_1, 4, -90.0, 90.0, 5)                                         \
+  X(a, INT, 0x53, CornerLongitude1, corner_longitude_1, 4, -180.0, 180.0, 5)                                     \
+  X(a, INT, 0x54, CornerLatitude2, corner_latitude_2, 4, -90.0, 90.0, 5)                                         \
+  X(a, INT, 0x55, CornerLongitude2, corner_longitude_2, 4, -180.0, 180.0, 5)                                     \
+  X(a, INT, 0x56, CornerLatitude3, corner_latitude_3, 4, -90.0, 90.0, 5)                                         \
+  X(a, INT, 0x57, CornerLongitude3, corner_longitude_3, 4, -180.0, 180.0, 5)                                     \
+  X(a, INT, 0x58, CornerLatitude4, corner_latitude_4, 4, -90.0, 90.0, 5)                                         \
+  X(a, INT, 0x59, CornerLongitude4, corner_longitude_4, 4, -180.0, 180.0, 5)                                     \
+  X(a, INT, 0x5A, PlatformPitchFull, platform_pitch_full, 4, -90.0, 90.0, 5)                                     \
+  X(a, INT, 0x5B, PlatformRollFull, platform_roll_full, 4, -90.0, 90.0, 5)                                       \
+  X(a, INT, 0x5C, PlatformAngleOfAttackFull, platform_angle_of_attack_full, 4, -90.0, 90.0, 5)                   \
+  X(a, INT, 0x5D, PlatformSideslipAngleFull, platform_sideslip_angle_full, 4, -90.0, 90.0, 5)                    \
+  X(a, BYTES, 0x5E, MiisCoreIdentifier, miis_core_identifier, 0, 0.0, 0.0, 6)                                    \
+  X(a, BYTES, 0x5F, SarMotionImageryLocalSet, sar_motion_imagery_local_set, 0, 0.0, 0.0, 7)                      \
+  X(a, BYTES, 0x60, TargetWidthExtended, target_width_extended, 0, 0.0, 0.0, 9)
+
+typedef enum klv_tag_type_e {
+  KLV_TYPE_NONE = 0, /* tag not described */
+  KLV_TYPE_UINT,     /* big-endian unsigned integer */
+  KLV_TYPE_INT,      /* big-endian two's complement integer */
+  KLV_TYPE_STRING,   /* variable length character data */
+  KLV_TYPE_BYTES,    /* variable length opaque data (nested sets, packs) */
+  KLV_TYPE_LATER,    /* tag added after the table's version, skipped */
+} klv_tag_type_t;
+
+/*
+ * Encoding of one ST0601 local set tag. Integer tags with min < max are mapped
+ * linearly from their integer range (0..2^n-1 unsigned, +/-(2^(n-1)-1) signed)
+ * onto [min, max]; with min == max the integer is the value itself.
+ * Enumerations name their values 0..num_values-1 in values[0, num_values),
+ * and any other value values[num_values] unless that is NULL.
+ */
+typedef struct klv_tag_desc_s {
+  uint8_t len;                /* encoded length in bytes, 0 for variable length */
+  uint8_t type;               /* klv_tag_type_t */
+  uint8_t num_values;         /* number of named values, 0 for no enumeration */
+  double min;                 /* mapped value of the lowest integer */
+  double max;                 /* mapped value of the highest integer */
+  const char *name;           /* identifier, e.g. "sensor_latitude" */
+  const char *const *values;  /* names of the values of an enumeration */
+} klv_tag_desc_t;
+
+extern const klv_tag_desc_t libklv_tags[256];
+
+/*
+ * Global prototypes
+ */
+const klv_tag_desc_t *libklv_tag_desc(uint8_t id);
+const klv_tag_desc_t *libklv_tag_table(uint8_t version);
+int libklv_tag_by_name(const char *name);
+double libklv_tag_raw_min(const klv_tag_desc_t *desc);
+double libklv_tag_raw_max(const klv_tag_desc_t *desc);
+
+#endif // LIBKLV_TAGS_H_INCLUDED
@@ -0,0 +1,236 @@
+#ifndef LIBKLV_TAGS_HPP_INCLUDED
+#define LIBKLV_TAGS_HPP_INCLUDED
+
+/*
+ * Compile-time typed access to ST0601 fields, e.g.
+ *
+ *   std::optional<int32_t> lat = klv::get<klv::tag::SensorLatitude>(packet);
+ *   std::optional<double> deg = klv::get_mapped<klv::tag::SensorLatitude>(packet);
+ *
+ * Each tag type carries its id, width, signedness and mapped range, so the
+ * value is read straight from the packet bytes with a fixed-width big-endian
+ * load: no decode_klv_values() switch, no descriptor lookup and no double
+ * unless get_mapped()/mapped() is asked for. The tags are generated from
+ * LIBKLV_ST0601_TAG_LIST, as libklv_tags[] is.
+ * Checksums are not verified here; see packet::checksum_valid().
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "libklv.hpp"
+
+namespace klv {
+
+namespace detail {
+
+template <size_t Width, bool Signed> struct raw_int;
+template <> struct raw_int<1, false> { using type = uint8_t; };
+template <> struct raw_int<1, true> { using type = int8_t; };
+template <> struct raw_int<2, false> { using type = uint16_t; };
+template <> struct raw_int<2, true> { using type = int16_t; };
+template <> struct raw_int<4, false> { using type = uint32_t; };
+template <> struct raw_int<4, true> { using type = int32_t; };
+template <> struct raw_int<8, false> { using type = uint64_t; };
+template <> struct raw_int<8, true> { using type = int64_t; };
+
+/* big-endian integer of Width bytes; two's complement for signed types */
+template <typename T, size_t Width>
+constexpr T read_be(const std::byte *p) noexcept {
+  using U = std::make_unsigned_t<T>;
+  U value = 0;
+  for (size_t i = 0; i < Width; i++)
+    value = static_cast<U>((value << 8) | std::to_integer<U>(p[i]));
+  return static_cast<T>(value);
+}
+
+/* BER length at p, as in klv_get_ber_length; false when malformed or truncated */
+inline bool read_ber(const std::byte *&p, const std::byte *end, uint64_t &len) noexcept {
+  if (p >= end)
+    return false;
+  len = std::to_integer<uint8_t>(*p++);
+  if (len & 0x80) {
+    size_t bytes_num = len & 0x7f;
+    if (bytes_num > 8 || static_cast<size_t>(end - p) < bytes_num)
+      return false;
+    len = 0;
+    while (bytes_num--)
+      len = len << 8 | std::to_integer<uint8_t>(*p++);
+  }
+  return true;
+}
+
+/*
+ * Call fn(id, value, len) for each item of the framed packet (universal key
+ * first) until fn returns true. Truncated items end the walk, as in
+ * libklv_parse_data.
+ */
+template <typename Fn>
+void for_each_field(std::span<const std::byte> packet, Fn &&fn) {
+  if (packet.size() < 17)
+    return;
+  const std::byte *p = packet.data() + 16;
+  const std::byte *end = packet.data() + packet.size();
+  uint64_t len = 0;
+  if (!read_ber(p, end, len))
+    return;
+  if (len < static_cast<uint64_t>(end - p))
+    end = p + len;
+
+  while (p + 2 <= end) {
+    uint8_t id = std::to_integer<uint8_t>(*p++);
+    if (!read_ber(p, end, len) || len > static_cast<uint64_t>(end - p))
+      return;
+    if (fn(id, p, static_cast<size_t>(len)))
+      return;
+    p += len;
+  }
+}
+
+} // namespace detail
+
+/* fixed-width integer tag, linearly mapped onto [Min, Max] when Min < Max */
+template <uint8_t Id, size_t Width, bool Signed, double Min, double Max>
+struct int_tag {
+  using raw_type = typename detail::raw_int<Width, Signed>::type;
+
+  static constexpr uint8_t id = Id;
+  static constexpr size_t width = Width;
+  static constexpr bool is_signed = Signed;
+  static constexpr bool is_mapped = Min < Max;
+  static constexpr double min = Min;
+  static constexpr double max = Max;
+  /* integer range mapped onto [min, max], as libklv_tag_raw_min/max */
+  static constexpr double raw_min = Signed ? -static_cast<double>((UINT64_C(1) << (8 * Width - 1)) - 1) : 0.0;
+  static constexpr double raw_max = Signed ? static_cast<double>((UINT64_C(1) << (8 * Width - 1)) - 1)
+                                           : static_cast<double>(std::numeric_limits<raw_type>::max());
+
+  /* like decode_klv_values, reads the first Width bytes and rejects shorter values */
+  static constexpr std::optional<raw_type> decode(const std::byte *value, size_t len) noexcept {
+    if (len < Width)
+      return std::nullopt;
+    return detail::read_be<raw_type, Width>(value);
+  }
+};
+
+/* variable length character data, viewed in place */
+template <uint8_t Id>
+struct string_tag {
+  using raw_type = std::string_view;
+
+  static constexpr uint8_t id = Id;
+
+  static std::optional<raw_type> decode(const std::byte *value, size_t len) noexcept {
+    return raw_type(reinterpret_cast<const char *>(value), len);
+  }
+};
+
+/* variable length opaque data (nested sets, packs), viewed in place */
+template <uint8_t Id>
+struct bytes_tag {
+  using raw_type = std::span<const std::byte>;
+
+  static constexpr uint8_t id = Id;
+
+  static constexpr std::optional<raw_type> decode(const std::byte *value, size_t len) noexcept {
+    return raw_type(value, len);
+  }
+};
+
+template <typename Tag>
+concept mapped_tag = requires { Tag::is_mapped; } && Tag::is_mapped;
+
+namespace tag {
+#define KLV_TAG_BASE_UINT(id, w, lo, hi) int_tag<id, w, false, lo, hi>
+#define KLV_TAG_BASE_INT(id, w, lo, hi) int_tag<id, w, true, lo, hi>
+#define KLV_TAG_BASE_ENUM(id, w, lo, hi) int_tag<id, w, false, lo, hi>
+#define KLV_TAG_BASE_STRING(id, w, lo, hi) string_tag<id>
+#define KLV_TAG_BASE_BYTES(id, w, lo, hi) bytes_tag<id>
+#define KLV_TAG(a, kind, id, type, n, w, lo, hi, since)                                                               \
+  struct type : KLV_TAG_BASE_##kind(id, w, lo, hi) { static constexpr std::string_view name = #n; };
+LIBKLV_ST0601_TAG_LIST(KLV_TAG, )
+#undef KLV_TAG
+#undef KLV_TAG_BASE_BYTES
+#undef KLV_TAG_BASE_STRING
+#undef KLV_TAG_BASE_ENUM
+#undef KLV_TAG_BASE_INT
+#undef KLV_TAG_BASE_UINT
+} // namespace tag
+
+/* raw value of the first Tag item in the packet */
+template <typename Tag>
+std::optional<typename Tag::raw_type> get(std::span<const std::byte> packet) noexcept {
+  std::optional<typename Tag::raw_type> out;
+  detail::for_each_field(packet, [&](uint8_t id, const std::byte *value, size_t len) {
+    if (id != Tag::id)
+      return false;
+    out = Tag::decode(value, len);
+    return true;
+  });
+  return out;
+}
+
+template <typename Tag>
+std::optional<typename Tag::raw_type> get(const packet &packet) noexcept {
+  return get<Tag>(packet.bytes());
+}
+
+/* raw value mapped onto the tag's range with libklv_map_val's arithmetic; nullopt when out of range */
+template <mapped_tag Tag>
+constexpr std::optional<double> mapped(typename Tag::raw_type raw) noexcept {
+  double value = static_cast<double>(raw);
+  if (value < Tag::raw_min || value > Tag::raw_max)
+    return std::nullopt;
+  double t = (value - Tag::raw_min) / (Tag::raw_max - Tag::raw_min);
+  return Tag::min + (t * (Tag::max - Tag::min));
+}
+
+template <mapped_tag Tag>
+std::optional<double> get_mapped(std::span<const std::byte> packet) noexcept {
+  std::optional<typename Tag::raw_type> raw = get<Tag>(packet);
+  return raw ? mapped<Tag>(*raw) : std::nullopt;
+}
+
+template <mapped_tag Tag>
+std::optional<double> get_mapped(const packet &packet) noexcept {
+  return get_mapped<Tag>(packet.bytes());
+}
+
+/*
+ * Raw values of several tags from a single walk over the packet, stopping as
+ * soon as all of them are found:
+ *
+ *   auto [lat, lon] = klv::get_all<klv::tag::SensorLatitude, klv::tag::SensorLongitude>(packet);
+ */
+template <typename... Tags>
+std::tuple<std::optional<typename Tags::raw_type>...> get_all(std::span<const std::byte> packet) noexcept {
+  static_assert(sizeof...(Tags) <= 64, "at most 64 tags per walk");
+  constexpr uint64_t all = (sizeof...(Tags) == 64) ? ~UINT64_C(0) : (UINT64_C(1) << sizeof...(Tags)) - 1;
+  std::tuple<std::optional<typename Tags::raw_type>...> out;
+  uint64_t seen = 0; /* bit I set once the first item for Tags[I] has been taken */
+  detail::for_each_field(packet, [&](uint8_t id, const std::byte *value, size_t len) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      (void)((id == Tags::id && !(seen & (UINT64_C(1) << I)) &&
+              (std::get<I>(out) = Tags::decode(value, len), seen |= UINT64_C(1) << I)) ||
+             ...);
+    }(std::index_sequence_for<Tags...>{});
+    return seen == all;
+  });
+  return out;
+}
+
+template <typename... Tags>
+std::tuple<std::optional<typename Tags::raw_type>...> get_all(const packet &packet) noexcept {
+  return get_all<Tags...>(packet.bytes());
+}
+
+} // namespace klv
+
+#endif // LIBKLV_TAGS_HPP_INCLUDED
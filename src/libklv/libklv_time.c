@@ -0,0 +1,87 @@
+#include "libklv_time.h"
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/*****************************************************************************
+ * write2
+ *****************************************************************************/
+static inline void write2(char *dst, uint32_t value) {
+  dst[0] = digit_pairs[2 * value];
+  dst[1] = digit_pairs[(2 * value) + 1];
+}
+
+/*****************************************************************************
+ * format_prefix
+ *
+ * Write "YYYY-MM-DDTHH:MM:" for the given minute since the epoch. The date is
+ * computed from the day count with integer arithmetic only (proleptic
+ * Gregorian calendar, days counted from 1970-01-01) instead of gmtime.
+ *****************************************************************************/
+static void format_prefix(char *dst, uint64_t minute) {
+  uint64_t days = minute / 1440;
+  uint32_t minute_of_day = (uint32_t)(minute % 1440);
+
+  uint64_t z = days + 719468; /* shift the epoch to 0000-03-01 */
+  uint64_t era = z / 146097;
+  uint32_t doe = (uint32_t)(z - (era * 146097));                               /* [0, 146096] */
+  uint32_t yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365; /* [0, 399] */
+  uint32_t doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));               /* [0, 365] */
+  uint32_t mp = ((5 * doy) + 2) / 153;                                        /* [0, 11] */
+  uint32_t day = doy - (((153 * mp) + 2) / 5) + 1;
+  uint32_t month = (mp < 10) ? mp + 3 : mp - 9;
+  uint32_t year = (uint32_t)((yoe + (era * 400) + (month <= 2)) % 10000);
+
+  write2(dst, year / 100);
+  write2(dst + 2, year % 100);
+  dst[4] = '-';
+  write2(dst + 5, month);
+  dst[7] = '-';
+  write2(dst + 8, day);
+  dst[10] = 'T';
+  write2(dst + 11, minute_of_day / 60);
+  dst[13] = ':';
+  write2(dst + 14, minute_of_day % 60);
+  dst[16] = ':';
+}
+
+/*****************************************************************************
+ * libklv_format_time
+ *
+ * Format microseconds since the epoch as an ISO 8601 UTC string with
+ * millisecond precision. The returned string lives in fmt and is valid until
+ * the next call with the same fmt. Reentrant: all state is in fmt.
+ *****************************************************************************/
+const char *libklv_format_time(klv_time_fmt_t *fmt, uint64_t usec) {
+  uint64_t second = usec / 1000000;
+  uint32_t millis = (uint32_t)((usec % 1000000) / 1000);
+  char *text = fmt->text;
+
+  if (!fmt->valid || second != fmt->second) {
+    uint64_t minute = second / 60;
+    if (!fmt->valid || minute != fmt->minute) {
+      format_prefix(text, minute);
+      text[19] = '.';
+      text[23] = 'Z';
+      text[24] = '\0';
+      fmt->minute = minute;
+      fmt->valid = true;
+    }
+    write2(text + 17, (uint32_t)(second % 60));
+    fmt->second = second;
+  }
+
+  text[20] = (char)('0' + (millis / 100));
+  write2(text + 21, millis % 100);
+
+  return text;
+}
@@ -0,0 +1,27 @@
+#ifndef LIBKLV_TIME_H_INCLUDED
+#define LIBKLV_TIME_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* length of "YYYY-MM-DDTHH:MM:SS.mmmZ", not counting the null-terminator */
+#define ISO_STRING_LEN 24
+
+/*
+ * Formatter state for one stream. The text of the last timestamp is kept so
+ * that consecutive timestamps within the same minute or second only rewrite
+ * the digits that changed. Zero-initialised state is valid (empty cache).
+ */
+typedef struct klv_time_fmt_s {
+  bool valid;      /* text holds a formatted timestamp */
+  uint64_t minute; /* minutes since the epoch of the cached date and hour-minute prefix */
+  uint64_t second; /* seconds since the epoch of the cached seconds field */
+  char text[ISO_STRING_LEN + 1];
+} klv_time_fmt_t;
+
+/*
+ * Global prototypes
+ */
+const char *libklv_format_time(klv_time_fmt_t *fmt, uint64_t usec);
+
+#endif // LIBKLV_TIME_H_INCLUDED
@@ -11,17 +11,17 @@ static inline void INIT_LIST_HEAD(struct list_head *list) {
   list->prev = list;
 }
 
-static inline void __list_add(struct list_head *new,
+static inline void __list_add(struct list_head *entry,
                               struct list_head *prev,
                               struct list_head *next) {
-  next->prev = new;
-  new->next = next;
-  new->prev = prev;
-  prev->next = new;
+  next->prev = entry;
+  entry->next = next;
+  entry->prev = prev;
+  prev->next = entry;
 }
 
-static inline void list_add_tail(struct list_head *new, struct list_head *head) {
-  __list_add(new, head->prev, head);
+static inline void list_add_tail(struct list_head *entry, struct list_head *head) {
+  __list_add(entry, head->prev, head);
 }
 
 /*
@@ -43,8 +43,37 @@ static inline void __list_del(struct list_head *prev, struct list_head *next) {
  */
 static inline void list_del(struct list_head *entry) {
   __list_del(entry->prev, entry->next);
-  entry->next = (void *)0;
-  entry->prev = (void *)0;
+  entry->next = (struct list_head *)0;
+  entry->prev = (struct list_head *)0;
+}
+
+/**
+ * list_empty - tests whether a list is empty
+ * @head: the list to test.
+ */
+static inline int list_empty(const struct list_head *head) {
+  return head->next == head;
+}
+
+/**
+ * list_splice_tail_init - join two lists and reinitialise the emptied list
+ * @list: the new list to add.
+ * @head: the place to add it in the first list.
+ *
+ * Each of the lists is a queue. The list at @list is reinitialised.
+ */
+static inline void list_splice_tail_init(struct list_head *list, struct list_head *head) {
+  if (!list_empty(list)) {
+    struct list_head *first = list->next;
+    struct list_head *last = list->prev;
+    struct list_head *at = head->prev;
+
+    first->prev = at;
+    at->next = first;
+    last->next = head;
+    head->prev = last;
+    INIT_LIST_HEAD(list);
+  }
 }
 
 /**
@@ -6,24 +6,252 @@
  */
 
 #include <inttypes.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "include/Config.h"
+#include "klv_batch.h"
+#include "klv_pipeline.h"
 #include "libklv/libklv.h"
+#include "libklv/libklv_aggregate.h"
+#include "libklv/libklv_archive.h"
+#include "libklv/libklv_decimate.h"
+#include "libklv/libklv_dedup.h"
+#include "libklv/libklv_filter.h"
+#include "libklv/libklv_mp4.h"
+#include "libklv/libklv_publish.h"
+#include "libklv/libklv_tags.h"
 
 const size_t BYTES_IN_A_MEGABYTE = 1048576;
 
 int read_data(uint8_t *buffer, FILE *in, size_t *size);
+int parse_format(const char *name, klv_output_format_t *format);
+int parse_fields(char *names, klv_aggregate_t *aggregate);
+int print_snapshot(const char *name);
+uint8_t *map_mp4(const char *path, size_t *size);
+void stop_following(int sig);
+
+void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [--format json|msgpack|cbor|record|archive|geojson|wkb|none] [--where filter] [--publish name] [--reorder seconds] [--dedup seconds] [--rate hz] [--min-move meters] [--min-turn degrees] [--pipeline] [file]\n", program);
+  fprintf(stderr, "       %s --follow [--format ...] [--aggregate field[,field...]] [--where filter] [--publish name] [--reorder seconds] [--dedup seconds] [--rate hz] [--min-move meters] [--min-turn degrees] file\n", program);
+  fprintf(stderr, "       %s --aggregate field[,field...] [--window seconds] [--where filter] [--publish name] [--reorder seconds] [--dedup seconds] [--rate hz] [--min-move meters] [--min-turn degrees] [--pipeline] [file]\n", program);
+  fprintf(stderr, "       %s --batch [--jobs n] [--out-dir dir] [--format json|msgpack|cbor|record|archive|geojson|wkb|none] [--where filter] file...\n",
+          program);
+  fprintf(stderr, "       %s --snapshot name\n", program);
+}
 
 int main(int argc, char **argv) {
   uint8_t *binary = NULL;
   size_t data_size = UINT32_MAX;
+  const char *input_path = NULL;
+  klv_output_format_t format = LIBKLV_OUTPUT_JSON;
+  bool pipeline = false;
+  bool batch = false;
+  bool follow = false;
+  klv_batch_options_t batch_options = {.jobs = 0, .out_dir = NULL};
+  klv_aggregate_t aggregate;
+  char *aggregate_fields = NULL;
+  double window = 10.0;
+  double reorder = -1.0;
+  klv_dedup_t dedup;
+  double dedup_window = -1.0;
+  klv_decimate_t decimate;
+  double rate = 0.0;
+  double min_move = -1.0;
+  double min_turn = -1.0;
+  klv_filter_t filter;
+  const char *where = NULL;
+  klv_publish_t *publish = NULL;
+  const char *publish_name = NULL;
+  const char **input_paths = (const char **)calloc((size_t)argc, sizeof(const char *));
+  size_t num_input_paths = 0;
+
+  if (input_paths == NULL)
+    return EXIT_FAILURE;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      if (parse_format(argv[++i], &format) < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--pipeline") == 0) {
+      pipeline = true;
+    } else if (strcmp(argv[i], "--follow") == 0) {
+      follow = pipeline = true;
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      batch = true;
+    } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      batch_options.jobs = (unsigned)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) {
+      batch_options.out_dir = argv[++i];
+    } else if (strcmp(argv[i], "--aggregate") == 0 && i + 1 < argc) {
+      aggregate_fields = argv[++i];
+    } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+      window = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--reorder") == 0 && i + 1 < argc) {
+      reorder = strtod(argv[++i], NULL);
+      pipeline = true;
+      if (reorder < 0.0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--dedup") == 0 && i + 1 < argc) {
+      dedup_window = strtod(argv[++i], NULL);
+      if (dedup_window < 0.0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+      rate = strtod(argv[++i], NULL);
+      if (rate <= 0.0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--min-move") == 0 && i + 1 < argc) {
+      min_move = strtod(argv[++i], NULL);
+      if (min_move < 0.0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--min-turn") == 0 && i + 1 < argc) {
+      min_turn = strtod(argv[++i], NULL);
+      if (min_turn < 0.0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--where") == 0 && i + 1 < argc) {
+      where = argv[++i];
+    } else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc) {
+      publish_name = argv[++i];
+    } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+      // Print the latest state another instance published, and exit.
+      free(input_paths);
+      return (print_snapshot(argv[++i]) < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+    } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      input_path = argv[i];
+      input_paths[num_input_paths++] = argv[i];
+    }
+  }
+
+  if (where != NULL && libklv_filter_compile(&filter, where) < 0) {
+    fprintf(stderr, "Invalid filter: %s\n", where);
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (aggregate_fields != NULL) {
+    // Summarize the given fields per window instead of writing every packet.
+    libklv_aggregate_init(&aggregate, (uint64_t)(window * 1e6));
+    if (batch || window <= 0.0 || parse_fields(aggregate_fields, &aggregate) < 0) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    format = LIBKLV_OUTPUT_JSON;
+  }
+
+  bool decimating = (rate > 0.0 || min_move >= 0.0 || min_turn >= 0.0);
+  if ((follow && input_path == NULL) || (batch && (follow || reorder >= 0.0 || dedup_window >= 0.0 || decimating))) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (dedup_window >= 0.0) {
+    // Drop copies of packets from redundant links before decoding them.
+    libklv_dedup_init(&dedup, (uint64_t)(dedup_window * 1e6));
+  }
+
+  if (decimating) {
+    // Thin the stream out to the rate and movement its consumers need, before decoding it.
+    libklv_decimate_init(&decimate, rate, min_move, min_turn);
+  }
+
+  if (publish_name != NULL) {
+    // Publish the latest state of the stream to other local processes, besides writing it.
+    if (batch) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    publish = libklv_publish_create(publish_name);
+    if (publish == NULL) {
+      fprintf(stderr, "Unable to publish to %s\n", publish_name);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (batch) {
+    // Decode every input file into its own output file on a pool of workers.
+    if (num_input_paths == 0) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+    batch_options.format = format;
+    batch_options.filter = (where != NULL) ? &filter : NULL;
+    int ret = klv_batch_run(input_paths, num_input_paths, &batch_options);
+    free(input_paths);
+    return (ret < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  free(input_paths);
+
+  if (format != LIBKLV_OUTPUT_JSON) {
+#if defined(_WIN32)
+    _setmode(_fileno(stdout), _O_BINARY); /* binary formats must not go through newline translation */
+#endif
+  }
 
-  if (argc > 1) {
+  if (pipeline) {
+    // Read, decode and write on separate threads, streaming the input in chunks.
+    FILE *in = (input_path != NULL) ? fopen(input_path, "rb") : stdin;
+    if (in == NULL) {
+      fprintf(stderr, "Unable to open %s\n", input_path);
+      return EXIT_FAILURE;
+    }
+    klv_pipeline_options_t options = {
+        .format = format,
+        .aggregate = (aggregate_fields != NULL) ? &aggregate : NULL,
+        .filter = (where != NULL) ? &filter : NULL,
+        .dedup = (dedup_window >= 0.0) ? &dedup : NULL,
+        .decimate = decimating ? &decimate : NULL,
+        .publish = publish,
+        .follow = follow ? input_path : NULL,
+        .reorder = (reorder >= 0.0),
+        .reorder_window = (reorder >= 0.0) ? (uint64_t)(reorder * 1e6) : 0,
+    };
+    if (follow) {
+      // Keep decoding what is appended to the file until interrupted.
+      signal(SIGINT, stop_following);
+      signal(SIGTERM, stop_following);
+    }
+    int ret = klv_pipeline_run(in, stdout, &options);
+    if (in != stdin)
+      fclose(in);
+    libklv_publish_close(publish);
+    return (ret < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  bool mapped = false;
+  if (input_path != NULL && (binary = map_mp4(input_path, &data_size)) != NULL) {
+    // The input file is an MP4 recording. Map it rather than reading it, since
+    // only the sample tables and the KLV samples are needed.
+    mapped = true;
+  } else if (input_path != NULL) {
     // The input file has been passed in the command line.
     // Read the data from it.
-    FILE *in_file = fopen(argv[1], "rb");
+    FILE *in_file = fopen(input_path, "rb");
     if (in_file) {
       fseek(in_file, 0, SEEK_END);
       data_size = ftell(in_file);
@@ -42,19 +270,60 @@ int main(int argc, char **argv) {
   }
   if (binary) {
     klv_ctx_t *context = libklv_init();
-    context->buffer = binary;
-    context->buffer_size = (uint16_t)data_size;
-    context->buf_ptr = binary;
-    context->buf_end = &binary[data_size];
+    libklv_set_output(context, stdout, format);
+    if (aggregate_fields != NULL)
+      context->writer.aggregate = &aggregate;
+    if (where != NULL)
+      context->filter = &filter;
+    context->writer.publish = publish;
+    if (dedup_window >= 0.0)
+      context->dedup = &dedup;
+    if (decimating)
+      context->decimate = &decimate;
 
-    libklv_parse_data(context);
+    if (libklv_is_archive(binary, data_size)) {
+      // Decode the archived packets instead of parsing KLV.
+      klv_archive_reader_t *reader = libklv_archive_reader_init(binary, data_size);
+      int ret = -1;
+      while (reader != NULL && (ret = libklv_archive_read_packet(reader, context)) > 0) {
+        struct list_head *items = &context->klv_items.list;
+        libklv_write_packet(&context->writer, items->next, items);
+      }
+      if (ret < 0)
+        fprintf(stderr, "Invalid archive\n");
+      libklv_archive_reader_cleanup(reader);
+    } else if (libklv_is_mp4(binary, data_size)) {
+      // Parse each sample of the KLV track in place.
+      klv_mp4_reader_t *reader = libklv_mp4_reader_init(binary, data_size);
+      int ret = -1;
+      while (reader != NULL && (ret = libklv_mp4_read_sample(reader, context, NULL)) > 0)
+        ;
+      if (reader == NULL)
+        fprintf(stderr, "No KLV track in %s\n", (input_path != NULL) ? input_path : "input");
+      else if (ret < 0)
+        fprintf(stderr, "Unable to parse a KLV sample\n");
+      libklv_mp4_reader_cleanup(reader);
+    } else {
+      libklv_borrow_ctx_buffer(context, binary, data_size);
+      libklv_parse_data(context);
+    }
+    if (dedup_window >= 0.0)
+      fprintf(stderr, "dedup: %" PRIu64 " duplicate packets dropped\n", dedup.duplicates);
+    if (decimating)
+      fprintf(stderr, "decimate: %" PRIu64 " packets kept, %" PRIu64 " dropped\n", decimate.kept, decimate.dropped);
 
     // Free the KLV Data
     libklv_cleanup(context);
 
     // Free the packet data
-    free(binary);
+#if !defined(_WIN32)
+    if (mapped)
+      munmap(binary, data_size);
+    else
+#endif
+      free(binary);
   }
+  libklv_publish_close(publish);
 
   return EXIT_SUCCESS;
 }
@@ -85,3 +354,93 @@ int read_data(uint8_t *buffer, FILE *in, size_t *size) {
 
   return 0;
 }
+
+int parse_format(const char *name, klv_output_format_t *format) {
+  if (strcmp(name, "json") == 0) {
+    *format = LIBKLV_OUTPUT_JSON;
+  } else if (strcmp(name, "msgpack") == 0) {
+    *format = LIBKLV_OUTPUT_MSGPACK;
+  } else if (strcmp(name, "cbor") == 0) {
+    *format = LIBKLV_OUTPUT_CBOR;
+  } else if (strcmp(name, "record") == 0) {
+    *format = LIBKLV_OUTPUT_RECORD;
+  } else if (strcmp(name, "archive") == 0) {
+    *format = LIBKLV_OUTPUT_ARCHIVE;
+  } else if (strcmp(name, "geojson") == 0) {
+    *format = LIBKLV_OUTPUT_GEOJSON;
+  } else if (strcmp(name, "wkb") == 0) {
+    *format = LIBKLV_OUTPUT_WKB;
+  } else if (strcmp(name, "none") == 0) {
+    *format = LIBKLV_OUTPUT_NONE;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+int parse_fields(char *names, klv_aggregate_t *aggregate) {
+  for (char *name = strtok(names, ","); name != NULL; name = strtok(NULL, ",")) {
+    int id = libklv_tag_by_name(name);
+    if (id < 0 || libklv_aggregate_add_field(aggregate, (uint8_t)id) < 0) {
+      fprintf(stderr, "Cannot aggregate %s\n", name);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+uint8_t *map_mp4(const char *path, size_t *size) {
+#if defined(_WIN32)
+  (void)path;
+  (void)size;
+  return NULL; /* read into memory instead */
+#else
+  uint8_t header[12];
+  struct stat st;
+  uint8_t *data = NULL;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) == 0 && pread(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+      libklv_is_mp4(header, sizeof(header))) {
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      data = (uint8_t *)p;
+      *size = (size_t)st.st_size;
+    }
+  }
+  close(fd);
+  return data;
+#endif
+}
+
+void stop_following(int sig) {
+  (void)sig;
+  klv_pipeline_stop(); /* the pipeline then finishes the output, e.g. the last archive block */
+}
+
+int print_snapshot(const char *name) {
+  klv_state_t state;
+  uint64_t packets;
+  klv_publish_t *publish = libklv_publish_open(name);
+
+  if (publish == NULL) {
+    fprintf(stderr, "Nothing published to %s\n", name);
+    return -1;
+  }
+  int ret = libklv_publish_read(publish, &state, &packets);
+  libklv_publish_close(publish);
+  if (ret <= 0) {
+    fprintf(stderr, (ret == 0) ? "Nothing published to %s yet\n" : "Publisher of %s stopped mid-update\n", name);
+    return -1;
+  }
+
+  printf("{\"packets\": %" PRIu64 ", \"timestamp\": %" PRIu64, packets, state.timestamp);
+  for (int f = 0; f < KLV_STATE_FIELD_COUNT; f++) {
+    if (state.valid & (1u << f))
+      printf(", \"%s\": %.15g", libklv_tag_desc(libklv_state_tag((klv_state_field_t)f))->name, state.field[f]);
+  }
+  printf("}\n");
+  return 0;
+}
@@ -0,0 +1,206 @@
+/**
+ * spsc_ring.h: bounded lock-free single-producer/single-consumer ring of preallocated slots
+ * @author Kongsberg Geospatial Ltd.
+ * @author www.kongsberggeospatial.com
+ * @copyright 2022 Kongsberg Geospatial Ltd.
+ */
+
+#ifndef SPSC_RING_H_INCLUDED
+#define SPSC_RING_H_INCLUDED
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#define SPSC_CACHE_LINE 64
+
+/*
+ * Slots live in the ring itself: the producer fills the slot returned by
+ * spsc_ring_write_slot() in place and publishes it with spsc_ring_commit();
+ * the consumer reads the slot from spsc_ring_read_slot() in place and hands
+ * it back with spsc_ring_release(). Nothing is copied or allocated after
+ * spsc_ring_init().
+ *
+ * head and tail are only ever written by one side each, and each side keeps a
+ * cached copy of the other side's index so it only touches the shared cache
+ * line when the ring looks full (or empty).
+ */
+typedef struct spsc_ring_s {
+  _Alignas(SPSC_CACHE_LINE) atomic_size_t head; /* next slot to write, advanced by the producer */
+  size_t cached_tail;                           /* producer's last view of tail */
+  uint64_t commits;                             /* slots published */
+  uint64_t full_waits;                          /* times the producer found the ring full */
+  size_t max_depth;                             /* highest occupancy seen by the producer */
+
+  _Alignas(SPSC_CACHE_LINE) atomic_size_t tail; /* next slot to read, advanced by the consumer */
+  size_t cached_head;                           /* consumer's last view of head */
+  uint64_t empty_waits;                         /* times the consumer found the ring empty */
+
+  _Alignas(SPSC_CACHE_LINE) atomic_bool closed; /* producer will not commit any more slots */
+  size_t mask;                                  /* capacity - 1, capacity is a power of two */
+  size_t slot_size;
+  uint8_t *slots;
+} spsc_ring_t;
+
+/*****************************************************************************
+ * spsc_ring_init
+ *****************************************************************************/
+static inline int spsc_ring_init(spsc_ring_t *ring, size_t capacity, size_t slot_size) {
+  size_t pow2 = 1;
+  while (pow2 < capacity)
+    pow2 <<= 1;
+
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->closed, false);
+  ring->cached_tail = 0;
+  ring->cached_head = 0;
+  ring->commits = 0;
+  ring->full_waits = 0;
+  ring->empty_waits = 0;
+  ring->max_depth = 0;
+  ring->mask = pow2 - 1;
+  ring->slot_size = (slot_size + SPSC_CACHE_LINE - 1) & ~(size_t)(SPSC_CACHE_LINE - 1);
+  ring->slots = (uint8_t *)calloc(pow2, ring->slot_size);
+
+  return (ring->slots != NULL) ? 0 : -1;
+}
+
+/*****************************************************************************
+ * spsc_ring_free
+ *****************************************************************************/
+static inline void spsc_ring_free(spsc_ring_t *ring) {
+  free(ring->slots);
+  ring->slots = NULL;
+}
+
+/*****************************************************************************
+ * spsc_ring_slot
+ *
+ * Slot storage by index, e.g. to set up per-slot state before the ring is used.
+ *****************************************************************************/
+static inline void *spsc_ring_slot(spsc_ring_t *ring, size_t index) {
+  return ring->slots + ((index & ring->mask) * ring->slot_size);
+}
+
+/*****************************************************************************
+ * spsc_ring_write_slot
+ *
+ * Producer: the next free slot, or NULL if the ring is full.
+ *****************************************************************************/
+static inline void *spsc_ring_write_slot(spsc_ring_t *ring) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  if (head - ring->cached_tail > ring->mask) {
+    ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - ring->cached_tail > ring->mask)
+      return NULL;
+  }
+  return spsc_ring_slot(ring, head);
+}
+
+/*****************************************************************************
+ * spsc_ring_commit
+ *
+ * Producer: publish the slot returned by spsc_ring_write_slot().
+ *****************************************************************************/
+static inline void spsc_ring_commit(spsc_ring_t *ring) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed) + 1;
+  size_t depth = head - ring->cached_tail;
+  if (depth > ring->max_depth)
+    ring->max_depth = depth;
+  ring->commits++;
+  atomic_store_explicit(&ring->head, head, memory_order_release);
+}
+
+/*****************************************************************************
+ * spsc_ring_read_slot
+ *
+ * Consumer: the oldest published slot, or NULL if the ring is empty.
+ *****************************************************************************/
+static inline void *spsc_ring_read_slot(spsc_ring_t *ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  if (tail == ring->cached_head) {
+    ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail == ring->cached_head)
+      return NULL;
+  }
+  return spsc_ring_slot(ring, tail);
+}
+
+/*****************************************************************************
+ * spsc_ring_release
+ *
+ * Consumer: hand the slot returned by spsc_ring_read_slot() back to the producer.
+ *****************************************************************************/
+static inline void spsc_ring_release(spsc_ring_t *ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/*****************************************************************************
+ * spsc_ring_close
+ *****************************************************************************/
+static inline void spsc_ring_close(spsc_ring_t *ring) {
+  atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+/*****************************************************************************
+ * spsc_ring_backoff
+ *
+ * Wait a little before retrying: spin first, since the other side usually
+ * catches up within a few hundred nanoseconds, then yield, then sleep so a
+ * stalled stage does not burn a core.
+ *****************************************************************************/
+static inline void spsc_ring_backoff(unsigned *spins) {
+  if (*spins < 64) {
+    (*spins)++;
+  } else if (*spins < 128) {
+    (*spins)++;
+    thrd_yield();
+  } else {
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = 50000};
+    thrd_sleep(&pause, NULL);
+  }
+}
+
+/*****************************************************************************
+ * spsc_ring_wait_write_slot
+ *
+ * Producer: block until a slot is free.
+ *****************************************************************************/
+static inline void *spsc_ring_wait_write_slot(spsc_ring_t *ring) {
+  unsigned spins = 0;
+  void *slot = spsc_ring_write_slot(ring);
+  if (slot == NULL) {
+    ring->full_waits++;
+    while ((slot = spsc_ring_write_slot(ring)) == NULL)
+      spsc_ring_backoff(&spins);
+  }
+  return slot;
+}
+
+/*****************************************************************************
+ * spsc_ring_wait_read_slot
+ *
+ * Consumer: block until a slot is published. Returns NULL once the ring is
+ * closed and drained.
+ *****************************************************************************/
+static inline void *spsc_ring_wait_read_slot(spsc_ring_t *ring) {
+  unsigned spins = 0;
+  void *slot = spsc_ring_read_slot(ring);
+  if (slot == NULL) {
+    ring->empty_waits++;
+    while ((slot = spsc_ring_read_slot(ring)) == NULL) {
+      if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+        /* the last commit happens before close, so check once more */
+        return spsc_ring_read_slot(ring);
+      }
+      spsc_ring_backoff(&spins);
+    }
+  }
+  return slot;
+}
+
+#endif // SPSC_RING_H_INCLUDED
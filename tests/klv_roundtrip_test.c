@@ -0,0 +1,218 @@
+/**
+ * klv_roundtrip_test.c: encoder -> parser -> archive writer -> archive reader round trip
+ * @author Kongsberg Geospatial Ltd.
+ * @author www.kongsberggeospatial.com
+ * @copyright 2022 Kongsberg Geospatial Ltd.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libklv/libklv.h"
+#include "libklv/libklv_archive.h"
+#include "libklv/libklv_encode.h"
+
+#define TEST_PACKETS (2 * LIBKLV_ARCHIVE_BLOCK_PACKETS + 7) /* two full blocks and part of a third */
+#define TEST_PACKET_SIZE 128
+#define TEST_TIME_START UINT64_C(1600000000000000)
+#define TEST_TIME_STEP 33333 /* microseconds, 30 Hz */
+
+typedef struct test_packet_s {
+  uint8_t bytes[TEST_PACKET_SIZE];
+  size_t len;
+} test_packet_t;
+
+static int failures;
+
+#define CHECK(cond, ...)                                               \
+  do {                                                                 \
+    if (!(cond)) {                                                     \
+      fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);       \
+      fprintf(stderr, __VA_ARGS__);                                    \
+      fputc('\n', stderr);                                             \
+      failures++;                                                      \
+    }                                                                  \
+  } while (0)
+
+/*****************************************************************************
+ * packet_time
+ *****************************************************************************/
+static uint64_t packet_time(size_t i) {
+  return TEST_TIME_START + i * TEST_TIME_STEP;
+}
+
+/*****************************************************************************
+ * encode_packet
+ *
+ * Packet i of the test stream: integer tags that change every packet, a
+ * string that changes every few hundred, and a constant version.
+ *****************************************************************************/
+static size_t encode_packet(size_t i, uint8_t *buf, size_t size) {
+  klv_encoder_t enc;
+  char mission[32];
+
+  snprintf(mission, sizeof(mission), "MISSION-%zu", i / 300);
+  libklv_encode_begin(&enc, buf, size);
+  libklv_encode_uint(&enc, 0x02, packet_time(i));
+  libklv_encode_string(&enc, 0x03, mission);
+  libklv_encode_value(&enc, 0x05, (double)((i * 7) % 360));
+  libklv_encode_value(&enc, 0x0D, 10.0 + (double)i * 1e-5);
+  libklv_encode_value(&enc, 0x0E, 20.0 - (double)i * 1e-5);
+  libklv_encode_value(&enc, 0x0F, 1000.0 + (double)(i % 50));
+  libklv_encode_uint(&enc, 0x41, LIBKLV_ST0601_VERSION);
+  return libklv_encode_end(&enc);
+}
+
+/*****************************************************************************
+ * reencode
+ *
+ * Encode the items decoded into ctx back into a packet, for comparing them
+ * with the packet they came from byte for byte.
+ *****************************************************************************/
+static size_t reencode(klv_ctx_t *ctx, uint8_t *buf, size_t size) {
+  klv_encoder_t enc;
+  struct list_head *pos;
+
+  libklv_encode_begin(&enc, buf, size);
+  list_for_each(pos, &ctx->klv_items.list) {
+    if (libklv_encode_item(&enc, list_entry(pos, klv_item_t, list)) < 0)
+      return 0;
+  }
+  return libklv_encode_end(&enc);
+}
+
+/*****************************************************************************
+ * check_packet
+ *
+ * Whether the packet decoded into ctx is packets[i].
+ *****************************************************************************/
+static int check_packet(klv_ctx_t *ctx, const test_packet_t *packets, size_t i, const char *stage) {
+  uint8_t buf[TEST_PACKET_SIZE];
+  size_t len = reencode(ctx, buf, sizeof(buf));
+
+  if (len != packets[i].len || memcmp(buf, packets[i].bytes, len) != 0) {
+    fprintf(stderr, "%s: packet %zu differs from the one encoded\n", stage, i);
+    failures++;
+    return -1;
+  }
+  return 0;
+}
+
+/*****************************************************************************
+ * read_file
+ *****************************************************************************/
+static uint8_t *read_file(FILE *f, size_t *size) {
+  long len;
+  uint8_t *data;
+
+  if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0)
+    return NULL;
+  data = (uint8_t *)malloc((size_t)len + 1);
+  if (data != NULL && fread(data, 1, (size_t)len, f) != (size_t)len) {
+    free(data);
+    return NULL;
+  }
+  *size = (size_t)len;
+  return data;
+}
+
+/*****************************************************************************
+ * check_seek
+ *
+ * Seek to timestamp and check that reading resumes at packet expected, or
+ * that the archive is at its end when expected is TEST_PACKETS.
+ *****************************************************************************/
+static void check_seek(klv_archive_reader_t *reader, klv_ctx_t *ctx, const test_packet_t *packets, uint64_t timestamp,
+                       size_t expected) {
+  int ret = libklv_archive_seek(reader, timestamp);
+
+  if (expected == TEST_PACKETS) {
+    CHECK(ret == 0, "seek to %" PRIu64 " returned %d, not the end", timestamp, ret);
+    CHECK(libklv_archive_read_packet(reader, ctx) == 0, "a packet after seeking past the end");
+    return;
+  }
+  CHECK(ret == 1, "seek to %" PRIu64 " returned %d", timestamp, ret);
+  ret = libklv_archive_read_packet(reader, ctx);
+  CHECK(ret == 1, "read after seeking to %" PRIu64 " returned %d", timestamp, ret);
+  if (ret == 1)
+    check_packet(ctx, packets, expected, "seek");
+}
+
+int main(void) {
+  test_packet_t *packets = (test_packet_t *)calloc(TEST_PACKETS, sizeof(test_packet_t));
+  klv_ctx_t *ctx = libklv_init();
+  FILE *archive = tmpfile();
+  klv_archive_writer_t *writer = (archive != NULL) ? libklv_archive_writer_init(archive) : NULL;
+  uint8_t *data = NULL;
+  size_t size = 0;
+
+  if (packets == NULL || ctx == NULL || writer == NULL) {
+    fprintf(stderr, "Unable to set up the test\n");
+    return 1;
+  }
+  libklv_set_output(ctx, NULL, LIBKLV_OUTPUT_NONE);
+  libklv_set_report(ctx, NULL, NULL);
+
+  /* encoder -> parser -> archive writer */
+  for (size_t i = 0; i < TEST_PACKETS; i++) {
+    packets[i].len = encode_packet(i, packets[i].bytes, sizeof(packets[i].bytes));
+    CHECK(packets[i].len > 0, "packet %zu did not fit", i);
+
+    libklv_update_ctx_buffer(ctx, packets[i].bytes, packets[i].len);
+    CHECK(libklv_parse_data(ctx) >= 0, "packet %zu did not parse", i);
+    check_packet(ctx, packets, i, "parse");
+
+    struct list_head *items = &ctx->klv_items.list;
+    CHECK(libklv_archive_write_packet(writer, items->next, items) == 0, "packet %zu was not archived", i);
+  }
+  CHECK(libklv_archive_writer_finish(writer) == 0, "the archive was not finished");
+  data = read_file(archive, &size);
+  fclose(archive);
+  CHECK(data != NULL, "the archive could not be read back");
+  if (data == NULL)
+    return 1;
+
+  /* a block holds LIBKLV_ARCHIVE_BLOCK_PACKETS packets, so there are three */
+  size_t num_blocks = 0;
+  size_t offset = 0;
+  while (size - offset >= LIBKLV_ARCHIVE_HEADER_SIZE && libklv_is_archive(data + offset, size - offset)) {
+    const uint8_t *header = data + offset;
+    uint32_t payload_size = (uint32_t)header[8] | (uint32_t)header[9] << 8 | (uint32_t)header[10] << 16 | (uint32_t)header[11] << 24;
+    uint32_t num_packets = (uint32_t)header[12] | (uint32_t)header[13] << 8 | (uint32_t)header[14] << 16 | (uint32_t)header[15] << 24;
+    uint32_t expected = (num_blocks < 2) ? LIBKLV_ARCHIVE_BLOCK_PACKETS : TEST_PACKETS - 2 * LIBKLV_ARCHIVE_BLOCK_PACKETS;
+    CHECK(num_packets == expected, "block %zu holds %" PRIu32 " packets, not %" PRIu32, num_blocks, num_packets, expected);
+    offset += LIBKLV_ARCHIVE_HEADER_SIZE + payload_size;
+    num_blocks++;
+  }
+  CHECK(num_blocks == 3 && offset == size, "%zu blocks over %zu of %zu bytes", num_blocks, offset, size);
+
+  /* archive reader, across the block boundaries */
+  klv_archive_reader_t *reader = libklv_archive_reader_init(data, size);
+  size_t count = 0;
+  int ret;
+  CHECK(reader != NULL, "no archive reader");
+  while (reader != NULL && (ret = libklv_archive_read_packet(reader, ctx)) > 0 && count < TEST_PACKETS)
+    check_packet(ctx, packets, count++, "archive");
+  CHECK(count == TEST_PACKETS, "%zu of %d packets read back", count, TEST_PACKETS);
+
+  /* seeking lands on the start of the first block that can hold the time stamp */
+  if (reader != NULL) {
+    check_seek(reader, ctx, packets, packet_time(LIBKLV_ARCHIVE_BLOCK_PACKETS + 10), LIBKLV_ARCHIVE_BLOCK_PACKETS);
+    check_seek(reader, ctx, packets, packet_time(LIBKLV_ARCHIVE_BLOCK_PACKETS - 1), 0);
+    check_seek(reader, ctx, packets, packet_time(LIBKLV_ARCHIVE_BLOCK_PACKETS), LIBKLV_ARCHIVE_BLOCK_PACKETS);
+    check_seek(reader, ctx, packets, packet_time(TEST_PACKETS - 1), 2 * LIBKLV_ARCHIVE_BLOCK_PACKETS);
+    check_seek(reader, ctx, packets, 0, 0);
+    check_seek(reader, ctx, packets, packet_time(TEST_PACKETS), TEST_PACKETS);
+  }
+
+  libklv_archive_reader_cleanup(reader);
+  libklv_cleanup(ctx);
+  free(data);
+  free(packets);
+
+  if (failures > 0)
+    fprintf(stderr, "%d checks failed\n", failures);
+  return (failures > 0) ? 1 : 0;
+}